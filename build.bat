@@ -14,8 +14,9 @@ del *.dll
 
 cd ..
 
-cl src/lib.c src/draw.c src/glad.c /Febin32/gamelib.dll /I "./include" /I "./thirdparty/include" /MT /link /DLL /LIBPATH:"./thirdparty/x32" glfw3.lib opengl32.lib kernel32.lib user32.lib shell32.lib gdi32.lib opengl32.lib
+cl src/lib.c src/draw.c src/drawlist.c src/glload.c src/glstate.c src/job.c src/memory.c src/mesh.c src/pack.c src/particles.c src/preload.c src/render.c src/shader.c src/spatial.c src/stats.c src/texcache.c src/texture.c src/thread.c src/tilemap.c src/glad.c /Febin32/gamelib.dll /I "./include" /I "./thirdparty/include" /MT /link /DLL /LIBPATH:"./thirdparty/x32" glfw3.lib opengl32.lib kernel32.lib user32.lib shell32.lib gdi32.lib opengl32.lib
 cl src/test.c /Febin32/game.exe /I "./include" /MT /link /SUBSYSTEM:CONSOLE
+cl tools/packer.c /Febin32/packer.exe /I "./include" /MT /link /SUBSYSTEM:CONSOLE
 
 del *.obj
 
@@ -1,6 +1,9 @@
 #ifndef GAMELIB_H
 #define GAMELIB_H
 
+#include <math.h>
+#include <stddef.h>
+
 #ifndef bool
 typedef int bool;
 #define true 1
@@ -17,11 +20,33 @@ typedef enum
 	BLEND_ADD,
 } blend_t;
 
+typedef enum
+{
+	FORMAT_RGBA,
+	FORMAT_BGRA,
+} textureformat_t;
+
 typedef void* handle_t;
 typedef handle_t font_t;
+typedef handle_t drawlist_t;
+typedef handle_t shader_t;
+typedef handle_t rendertarget_t;
+typedef handle_t mesh_t;
+typedef handle_t tilemap_t;
+typedef handle_t particles_t;
+typedef handle_t spatialgrid_t;
 typedef unsigned int texture_t;
 typedef unsigned int color_t;
 
+typedef void (*job_func)(void* data);
+typedef void (*job_range_func)(void* data, int first, int last);
+
+//tracks outstanding jobs, zero-initialize before use and don't touch while jobs are in flight
+typedef struct
+{
+	volatile long long pending;
+} jobcounter_t;
+
 typedef bool (*callback_start)(void);
 typedef bool (*callback_loop)(void);
 typedef void (*callback_stop)(void);
@@ -37,13 +62,165 @@ typedef struct
 	float u,v;
 } vertex_t;
 
+//vertex with its own color, these batch together regardless of set_color
+typedef struct
+{
+	float x,y;
+	float u,v;
+	color_t color;
+} colorvertex_t;
+
+//2D affine transform, x' = m[0]*x + m[2]*y + m[4], y' = m[1]*x + m[3]*y + m[5]
+typedef struct
+{
+	float m[6];
+} transform_t;
+
+//x, y is the world position shown in the middle of the view
+typedef struct
+{
+	float x,y;
+	float zoom;
+	float rotation;
+} camera_t;
+
+typedef struct
+{
+	float x,y;
+	float dx,dy;
+	float time;
+} mousesample_t;
+
+//milliseconds spent in each phase of init
+typedef struct
+{
+	float window;
+	float gl_load;
+	float gfx;
+	float preload; //from reading the manifest until the last upload, overlaps the phases above
+	float total;
+} inittimes_t;
+
+//replaces malloc for everything the library allocates, image and font decoding included.
+//must be thread safe, allocations are made from the job and render threads
+typedef struct
+{
+	void* (*alloc)(void* user, size_t size);
+	void* (*realloc)(void* user, void* ptr, size_t size);
+	void (*free)(void* user, void* ptr);
+	void* user;
+} allocator_t;
+
+typedef enum
+{
+	MEMORY_GENERAL,
+	MEMORY_IMAGE, //decoded pixels before upload
+	MEMORY_FONT, //font files, glyph bitmaps and metrics
+	MEMORY_GEOMETRY, //batch, mesh and tilemap vertices
+	MEMORY_DRAWLIST,
+	MEMORY_PARTICLES,
+	MEMORY_SPATIAL,
+	MEMORY_SHADER,
+	MEMORY_FRAME, //frame arenas and scratch that didn't fit in them
+	MEMORY_CATEGORY_COUNT,
+} memorycategory_t;
+
+//heap use by the library, per category
+typedef struct
+{
+	long long bytes[MEMORY_CATEGORY_COUNT];
+	long long peak_bytes[MEMORY_CATEGORY_COUNT];
+	long long allocations[MEMORY_CATEGORY_COUNT]; //live blocks
+} memoryusage_t;
+
+//why a batch of quads was sent to the GPU
+typedef enum
+{
+	FLUSH_FULL, //the batch buffer filled up
+	FLUSH_TEXTURE,
+	FLUSH_BLEND,
+	FLUSH_SHADER, //shader or uniform change
+	FLUSH_VIEW, //camera, transform or viewport change
+	FLUSH_TARGET, //render target change or clear
+	FLUSH_DRAW, //mesh, particles or tilemap drawn outside the batch
+	FLUSH_RESOURCE, //texture, font, mesh or render target created, updated or freed
+	FLUSH_FRAME, //end of frame
+	FLUSH_REASON_COUNT,
+} flushreason_t;
+
+//work done by the gfx layer in one frame
+typedef struct
+{
+	int draw_calls;
+	int batches;
+	int flushes[FLUSH_REASON_COUNT];
+	int vertices;
+	int indices;
+	int texture_binds;
+	int blend_changes;
+	int state_calls; //every GL state change sent to the driver
+	int state_calls_filtered; //redundant ones skipped
+	long long bytes_uploaded; //vertex, index, instance and texture data
+	int glyphs;
+	long long texture_bytes; //estimated GPU memory held by textures at the end of the frame
+	int textures_evicted;
+	int textures_reloaded;
+} renderstats_t;
+
+//overlapping objects, a < b
+typedef struct
+{
+	int a, b;
+} spatialpair_t;
+
+//size and color are interpolated from start to end over each particle's life,
+//drag is the fraction of velocity lost per second
+typedef struct
+{
+	texture_t texture;
+	float gravity_x, gravity_y;
+	float drag;
+	float start_size, end_size;
+	color_t start_color, end_color;
+} particleparams_t;
+
+//particles leave x, y heading angle +- spread/2 radians
+typedef struct
+{
+	float x,y;
+	float angle, spread;
+	float min_speed, max_speed;
+	float min_life, max_life;
+} particleemit_t;
+
+//zeroed options give the load_font atlas, printable ascii with 2x horizontal oversampling
+typedef struct
+{
+	int oversample; //horizontal samples per pixel for smooth sub-pixel placement, 1-8. 1 snaps glyphs to whole pixels
+	int first_char; //range of characters in the atlas, num_chars 0 for 32-127
+	int num_chars;
+	bool pixelated; //nearest filtering, for bitmap style fonts drawn at their native size
+} fontoptions_t;
+
 typedef struct
 {
 	texture_t (*load_texture)(const char* filename);
 	font_t (*load_font)(const char* filename);
+	//pixel_size is the line height, 0 for the 24px of load_font. sizes of the same file share
+	//the parsed font and each gets an atlas sized to its glyphs, options can be NULL
+	font_t (*load_font_ex)(const char* filename, int pixel_size, const fontoptions_t* options);
+	//decode from a buffer holding the file's contents. the buffer is only read during the call,
+	//with adopt it must come from initparams_t.allocator (malloc by default) and the library frees it
+	texture_t (*load_texture_memory)(const void* buffer, int size, bool adopt);
+	font_t (*load_font_memory)(const void* buffer, int size, bool adopt);
 	void (*free_texture)(texture_t texture);
 	void (*free_font)(font_t font);
 
+	//textures whose contents are replaced after creation, e.g. video frames. updates are
+	//streamed through buffers so they don't block on the GPU, pixels are tightly packed rows
+	texture_t (*create_texture)(int width, int height, textureformat_t format);
+	void (*update_texture)(texture_t texture, int x, int y, int width, int height, const void* pixels);
+
 	void (*set_blend)(blend_t blendmode);
 	void (*set_texture)(texture_t texture);
 	void (*set_color)(color_t color);
@@ -53,12 +230,141 @@ typedef struct
 	void (*draw_quad)(vertex_t vertices[4]);
 	void (*draw_polygon)(vertex_t* vertices, int num_vertices);
 	void (*draw_text)(font_t font, float x, float y, const char* text);
+	void (*draw_quad_colored)(colorvertex_t vertices[4]);
+	void (*draw_polygon_colored)(colorvertex_t* vertices, int num_vertices);
+
+	//user shaders (core profile only). a NULL vertex shader uses the built-in one, which feeds
+	//the fragment shader 'in vec2 v_texcoord', 'in vec4 v_color' and 'uniform sampler2D u_texture'
+	shader_t (*load_shader)(const char* vertex_filename, const char* fragment_filename);
+	shader_t (*create_shader)(const char* vertex_source, const char* fragment_source);
+	void (*free_shader)(shader_t shader);
+	//NULL returns to the built-in shaders
+	void (*set_shader)(shader_t shader);
+	//uniforms apply to the current shader, unchanged values are skipped
+	void (*set_uniform_int)(const char* name, int value);
+	void (*set_uniform_float)(const char* name, float value);
+	void (*set_uniform_vec2)(const char* name, float x, float y);
+	void (*set_uniform_vec4)(const char* name, float x, float y, float z, float w);
+
+	//offscreen targets, drawing goes to the target with its own width x height
+	//coordinates until set_render_target(NULL). the window is restored every frame
+	rendertarget_t (*create_render_target)(int width, int height);
+	void (*free_render_target)(rendertarget_t target);
+	void (*set_render_target)(rendertarget_t target);
+	//the target's contents as a texture for set_texture, owned by the target
+	texture_t (*get_render_target_texture)(rendertarget_t target);
+	//clears the current target or the window
+	void (*clear)(color_t color);
+
+	//static triangle meshes uploaded once, drawn with the current texture and shader.
+	//vertex colors are used as-is, transform may be NULL
+	mesh_t (*create_mesh)(const colorvertex_t* vertices, int num_vertices, const unsigned int* indices, int num_indices);
+	void (*free_mesh)(mesh_t mesh);
+	void (*draw_mesh)(mesh_t mesh, const transform_t* transform);
+
+	//the camera and transform stack apply to everything drawn after them, sprites and rects
+	//outside the view are skipped. a NULL camera draws in screen coordinates
+	void (*set_camera)(const camera_t* camera);
+	void (*push_transform)(const transform_t* transform);
+	void (*pop_transform)(void);
+
+	//particle systems hold up to max_particles, updated across the job threads and drawn
+	//with one instanced draw using the current blend mode
+	particles_t (*create_particles)(int max_particles, const particleparams_t* params);
+	void (*free_particles)(particles_t particles);
+	void (*emit_particles)(particles_t particles, int count, const particleemit_t* emit);
+	void (*update_particles)(particles_t particles, float dt);
+	void (*draw_particles)(particles_t particles);
+	int (*particle_count)(particles_t particles);
+
+	//width x height tile grid sampled from an atlas of atlas_columns x atlas_rows equal cells.
+	//tiles are atlas cell indices up to 32767, row major, -1 for empty (the default).
+	//set_tile ignores larger indices
+	tilemap_t (*create_tilemap)(int width, int height, float tile_size, texture_t atlas, int atlas_columns, int atlas_rows);
+	void (*free_tilemap)(tilemap_t tilemap);
+	void (*set_tile)(tilemap_t tilemap, int x, int y, int tile);
+	int (*get_tile)(tilemap_t tilemap, int x, int y);
+	//draws the chunks that overlap the view with the map's top left corner at x, y
+	void (*draw_tilemap)(tilemap_t tilemap, float x, float y);
+
+	//GL state changes sent to the driver and redundant ones skipped during the last frame
+	void (*get_state_calls)(int* issued, int* filtered);
+	//counters for the last finished frame, they restart every update (on the render thread
+	//they describe the frame it last drew)
+	void (*get_render_stats)(renderstats_t* stats);
+
+	//draw lists record the same primitives without touching GL, so any thread can fill one.
+	//a list must only be used by one thread at a time and submitted from the main thread.
+	drawlist_t (*create_drawlist)(void);
+	void (*free_drawlist)(drawlist_t list);
+	void (*drawlist_reset)(drawlist_t list);
+	void (*drawlist_set_blend)(drawlist_t list, blend_t blendmode);
+	void (*drawlist_set_texture)(drawlist_t list, texture_t texture);
+	void (*drawlist_set_color)(drawlist_t list, color_t color);
+	void (*drawlist_rect)(drawlist_t list, float x, float y, float width, float height);
+	void (*drawlist_sprite)(drawlist_t list, float x, float y, float width, float height, float rotation);
+	void (*drawlist_quad)(drawlist_t list, vertex_t vertices[4]);
+	void (*drawlist_polygon)(drawlist_t list, vertex_t* vertices, int num_vertices);
+	void (*drawlist_text)(drawlist_t list, font_t font, float x, float y, const char* text);
+	void (*drawlist_quad_colored)(drawlist_t list, colorvertex_t vertices[4]);
+	void (*drawlist_polygon_colored)(drawlist_t list, colorvertex_t* vertices, int num_vertices);
+	void (*drawlist_set_shader)(drawlist_t list, shader_t shader);
+	void (*drawlist_set_uniform_int)(drawlist_t list, const char* name, int value);
+	void (*drawlist_set_uniform_float)(drawlist_t list, const char* name, float value);
+	void (*drawlist_set_uniform_vec2)(drawlist_t list, const char* name, float x, float y);
+	void (*drawlist_set_uniform_vec4)(drawlist_t list, const char* name, float x, float y, float z, float w);
+	void (*drawlist_mesh)(drawlist_t list, mesh_t mesh, const transform_t* transform);
+	void (*drawlist_tilemap)(drawlist_t list, tilemap_t tilemap, float x, float y);
+	void (*drawlist_set_camera)(drawlist_t list, const camera_t* camera);
+	void (*drawlist_push_transform)(drawlist_t list, const transform_t* transform);
+	void (*drawlist_pop_transform)(drawlist_t list);
+	//pixels are copied into the list
+	void (*drawlist_update_texture)(drawlist_t list, texture_t texture, int x, int y, int width, int height, const void* pixels);
+	//replays lists in array order, lists are left intact until reset
+	void (*submit_drawlists)(drawlist_t* lists, int num_lists);
 } libgfx_t;
 
 typedef struct
 {
 	float (*get_time)(void);
 	float (*get_deltatime)(void);
+	const inittimes_t* (*get_init_times)(void);
+
+	//mouse motion accumulated over the last event poll
+	void (*get_mouse_delta)(float* dx, float* dy);
+	//every cursor sample from the last event poll (raw_mousemove only)
+	int (*get_mouse_samples)(const mousesample_t** samples);
+
+	//jobs may be submitted from the main thread or from inside other jobs. job_submit also
+	//works from other threads, e.g. the render thread, and the workers pick those jobs up
+	void (*job_submit)(job_func func, void* data, jobcounter_t* counter);
+	//runs func once dependency reaches zero
+	void (*job_submit_after)(job_func func, void* data, jobcounter_t* dependency, jobcounter_t* counter);
+	//splits [0, count) into ranges of batch_size, waits for completion if counter is NULL
+	void (*job_parallel_for)(job_range_func func, void* data, int count, int batch_size, jobcounter_t* counter);
+	//runs other jobs until the counter reaches zero
+	void (*job_wait)(jobcounter_t* counter);
+	int (*job_thread_count)(void);
+
+	//scratch memory valid until the end of the next frame, never freed by the caller.
+	//align must be a power of two (0 for 16), returns NULL once the frame's arena is full
+	void* (*frame_alloc)(int size, int align);
+	void (*get_memory_usage)(memoryusage_t* usage);
+
+	//broadphase over axis aligned rects. ids stay valid until removed and are reused after.
+	//the grid reindexes on the first query after a change, once it has, queries only read
+	//and can run from jobs. query and pairs return the total found, writing at most max
+	spatialgrid_t (*create_spatial_grid)(float cell_size);
+	void (*free_spatial_grid)(spatialgrid_t grid);
+	int (*spatial_insert)(spatialgrid_t grid, float x, float y, float width, float height);
+	void (*spatial_update)(spatialgrid_t grid, int id, float x, float y, float width, float height);
+	void (*spatial_remove)(spatialgrid_t grid, int id);
+	int (*spatial_query)(spatialgrid_t grid, float x, float y, float width, float height, int* results, int max_results);
+	int (*spatial_pairs)(spatialgrid_t grid, spatialpair_t* pairs, int max_pairs);
+
+	//maps an archive built by tools/packer. loads look in the most recently mounted one first
+	//and fall back to the filesystem, archived files are decoded in place without copies
+	bool (*mount_pack)(const char* filename);
 } libutil_t;
 
 typedef struct
@@ -74,6 +380,20 @@ typedef struct
 	callback_mousemove cb_mousemove;
 	callback_mouseenter cb_mouseenter;
 	callback_keyboard cb_keyboard;
+	bool coalesce_mousemove; //call cb_mousemove at most once per frame
+	bool raw_mousemove; //capture the cursor and record unaccelerated sub-frame motion
+	int job_threads; //worker threads, 0 uses one per core minus the main thread, negative for none
+	int frame_memory; //bytes per frame_alloc arena, 0 for 4MB. all of it is the game's, the library's own
+	                  //per-frame scratch has separate arenas
+	const allocator_t* allocator; //NULL for malloc, must outlive shutdown
+	int texture_budget; //MB of textures kept on the GPU, 0 for no limit. past it textures loaded from files that
+	                    //weren't drawn in the frame are evicted, drawing one reloads it in the background
+	                    //and it shows as its average color until then
+	bool render_thread; //record gfx calls and draw them one frame behind on a dedicated GL thread
+	bool gl_compat; //legacy fixed-function pipeline instead of the GL 3.3 core profile renderer
+	const char* asset_pack; //archive built by tools/packer, searched before the filesystem by every load
+	const char* preload_manifest; //text file of textures and fonts (.ttf) decoded on the job threads while the window opens,
+	                              //one per line. load_texture and load_font in cb_start return them without touching disk
 } initparams_t;
 
 typedef struct
@@ -87,8 +407,39 @@ typedef struct
 
 typedef gamelib_t* (*pfn_get_game_lib)(void);
 
+#ifdef GAMELIB_STATIC
+
+//static builds link the library into the game. get_game_lib is called directly and the hot draw
+//path can skip the tables so LTO can inline it, these draw immediately so they can't be mixed
+//with render_thread (draw lists are fine from any thread)
+extern gamelib_t* get_game_lib(void);
+
+extern void _set_blend(blend_t blendmode);
+extern void _set_texture(texture_t texture);
+extern void _set_color(color_t color);
+extern void _draw_rect(float x, float y, float width, float height);
+extern void _draw_sprite(float x, float y, float width, float height, float rotation);
+extern void _draw_quad(vertex_t vertices[4]);
+extern void _draw_polygon(vertex_t* vertices, int num_vertices);
+extern void _draw_text(font_t font, float x, float y, const char* text);
+extern void _draw_quad_colored(colorvertex_t vertices[4]);
+extern void _draw_polygon_colored(colorvertex_t* vertices, int num_vertices);
+
+extern void _drawlist_set_blend(drawlist_t list, blend_t blendmode);
+extern void _drawlist_set_texture(drawlist_t list, texture_t texture);
+extern void _drawlist_set_color(drawlist_t list, color_t color);
+extern void _drawlist_rect(drawlist_t list, float x, float y, float width, float height);
+extern void _drawlist_sprite(drawlist_t list, float x, float y, float width, float height, float rotation);
+
+#endif //GAMELIB_STATIC
+
 #ifdef GAMELIB_WITH_BOOTSTRAP
-#ifdef _WIN32
+#if defined(GAMELIB_STATIC)
+
+static bool init_game_lib(void) { return true; }
+static void free_game_lib(void) {}
+
+#elif defined(_WIN32)
 
 #include <stdio.h>
 #include <windows.h>
@@ -125,7 +476,37 @@ static void free_game_lib(void)
 	FreeLibrary( _game_lib_module );
 }
 
-#endif //_WIN32
+#else
+
+#include <stdio.h>
+#include <dlfcn.h>
+
+static pfn_get_game_lib get_game_lib;
+static void* _game_lib_module = NULL;
+
+static bool init_game_lib(void)
+{
+	_game_lib_module = dlopen("libgamelib.so", RTLD_NOW);
+	if ( _game_lib_module == NULL ) _game_lib_module = dlopen("./libgamelib.so", RTLD_NOW);
+	if ( _game_lib_module == NULL )
+	{
+		printf("Error loading library %s\n", dlerror());
+		return false;
+	}
+
+	get_game_lib = (pfn_get_game_lib) dlsym( _game_lib_module, "get_game_lib" );
+
+	return get_game_lib != NULL;
+}
+
+static void free_game_lib(void)
+{
+	get_game_lib = NULL;
+
+	dlclose( _game_lib_module );
+}
+
+#endif //GAMELIB_STATIC / _WIN32
 #endif //GAMELIB_WITH_BOOTSTRAP
 
 //KEYS
@@ -272,27 +653,38 @@ static void free_game_lib(void)
 #define MOUSE_BUTTON_RIGHT     MOUSE_BUTTON_2
 #define MOUSE_BUTTON_MIDDLE    MOUSE_BUTTON_3
 
-inline color_t COLOR3(int r, int g, int b)
+static inline color_t COLOR3(int r, int g, int b)
 {
 	return 0xFF000000 | ((b & 0xFF) << 16) | ((g & 0xFF) << 8) | (r & 0xFF);
 }
 
-inline color_t COLOR4(int r, int g, int b, int a)
+static inline color_t COLOR4(int r, int g, int b, int a)
 {
 	return ((a & 0xFF) << 24) | ((b & 0xFF) << 16) | ((g & 0xFF) << 8) | (r & 0xFF);
 }
 
-inline color_t COLOR3F(float r, float g, float b)
+static inline color_t COLOR3F(float r, float g, float b)
 {
 	return COLOR3( (int)(r * 255.f), (int)(g * 255.f), (int)(b * 255.f) );
 }
 
-inline color_t COLOR4F(float r, float g, float b, float a)
+static inline color_t COLOR4F(float r, float g, float b, float a)
 {
 	return COLOR4( (int)(r * 255.f), (int)(g * 255.f), (int)(b * 255.f), (int)(a * 255.f) );
 }
 
-inline float DEGREES(float radians) { return radians * 57.3f; }
-inline float RADIANS(float degrees) { return degrees / 57.3f; }
+static inline transform_t TRANSFORM(float x, float y, float rotation, float scale)
+{
+	transform_t t;
+	float c = cosf(rotation) * scale;
+	float s = sinf(rotation) * scale;
+	t.m[0] = c; t.m[1] = s;
+	t.m[2] = -s; t.m[3] = c;
+	t.m[4] = x; t.m[5] = y;
+	return t;
+}
+
+static inline float DEGREES(float radians) { return radians * 57.3f; }
+static inline float RADIANS(float degrees) { return degrees / 57.3f; }
 
 #endif //GAMELIB_H
\ No newline at end of file
@@ -1,35 +1,264 @@
 #define STB_IMAGE_IMPLEMENTATION
+#define STB_RECT_PACK_IMPLEMENTATION
 #define STB_TRUETYPE_IMPLEMENTATION
 
 #include "draw.h"
+#include "glstate.h"
+#include "memory.h"
+#include "pack.h"
+#include "preload.h"
+#include "shader.h"
+#include "stats.h"
+#include "texcache.h"
+#include "thread.h"
+
+//decoding allocates through the library's allocator so it's counted and hooked like the rest
+#define STBI_MALLOC(size) mem_alloc(size, MEMORY_IMAGE)
+#define STBI_REALLOC(ptr, size) mem_realloc(ptr, size, MEMORY_IMAGE)
+#define STBI_FREE(ptr) mem_free(ptr)
+#define STBTT_malloc(size, user) ((void) (user), mem_alloc(size, MEMORY_FONT))
+#define STBTT_free(ptr, user) ((void) (user), mem_free(ptr))
+
 #include "stb_image.h"
+#include "stb_rect_pack.h"
 #include "stb_truetype.h"
 #include <glad/glad.h>
 
 #define MAX_FONTS 64
+#define DEFAULT_FONT_SIZE 24
+#define DEFAULT_OVERSAMPLE 2
+#define MAX_ATLAS_SIZE 4096
+#define MAX_BATCH_QUADS 4096
+#define MAX_TRANSFORMS 32
 
 typedef struct
 {
 	color_t color;
 	blend_t blend;
 	texture_t texture;
+	bool alpha_texture; //bound texture is a single channel font atlas
+	shader_t shader;
 } state_t;
 
+//core profile quads are staged here and drawn as indexed triangles on texture, blend
+//or program changes
+typedef struct
+{
+	GLuint vao;
+	GLuint vbo;
+	GLuint ibo;
+	colorvertex_t* vertices;
+	int num_quads;
+	float projection[16];
+	int projection_serial;
+	float model[16];
+	int model_serial;
+	program_t programs[PROGRAM_COUNT];
+} batch_t;
+
+typedef struct
+{
+	GLuint framebuffer;
+	GLuint texture;
+	int width;
+	int height;
+} rendertargetdata_t;
+
+//camera and transform stack, folded into the projection so batched vertices stay untouched.
+//bounds is the visible area in world space used to reject sprites before they're batched
+typedef struct
+{
+	int width;
+	int height;
+	bool flip;
+	bool has_camera;
+	camera_t camera;
+	transform_t stack[MAX_TRANSFORMS];
+	int depth;
+	float bounds[4];
+} view_t;
+
+//a parsed font file, shared by every size loaded from it
+typedef struct fontface_s
+{
+	char* filename;
+	unsigned char* data; //NULL when read in place from the asset pack
+	stbtt_fontinfo info;
+	int refs;
+	struct fontface_s* next;
+} fontface_t;
+
 typedef struct fontdata_s
 {
 	texture_t texture;
-	stbtt_bakedchar characters[96];
+	stbtt_packedchar* characters;
+	int first_char;
+	int num_chars;
+	bool snap; //no oversampling, glyphs are placed on whole pixels
 	int width;
 	int height;
+	fontface_t* face;
 	struct fontdata_s* next;
 } fontdata_t;
 
 static state_t g_state;
 static fontdata_t *g_fonts = NULL;
+static fontface_t* g_faces = NULL;
+static mutex_t g_face_lock = NULL; //fonts are baked on the job threads while preloading
+static bool g_compat = false;
+static batch_t g_batch;
+static rendertargetdata_t* g_target = NULL;
+static int g_window_width = 0;
+static int g_window_height = 0;
+static view_t g_view;
+
+static bool view_rejects(float x0, float y0, float x1, float y1)
+{
+	return x1 < g_view.bounds[0] || y1 < g_view.bounds[1] || x0 > g_view.bounds[2] || y0 > g_view.bounds[3];
+}
+
+static void set_model(const float* model)
+{
+	static const float identity[16] = { 1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1 };
+	if ( model == NULL ) model = identity;
+	if ( memcmp(g_batch.model, model, sizeof(float) * 16) == 0 ) return;
+
+	memcpy(g_batch.model, model, sizeof(float) * 16);
+	g_batch.model_serial++;
+}
+
+//textures are bound when something draws with them, so switching back and forth between
+//draws costs nothing
+void apply_texture(void)
+{
+	touch_texture(g_state.texture);
+	gl_bind_texture(0, g_state.texture);
+}
+
+static void bind(program_t* program, const float* model)
+{
+	gl_use_program(program->program);
+	apply_texture();
+	set_model(model);
+
+	if ( program->projection_serial != g_batch.projection_serial )
+	{
+		program->projection_serial = g_batch.projection_serial;
+		glUniformMatrix4fv(program->u_projection, 1, GL_FALSE, g_batch.projection);
+	}
+
+	if ( program->model_serial != g_batch.model_serial )
+	{
+		program->model_serial = g_batch.model_serial;
+		glUniformMatrix4fv(program->u_model, 1, GL_FALSE, g_batch.model);
+	}
+}
+
+//binds the program for the current state and brings its matrices up to date
+void bind_program(const float* model)
+{
+	program_t* program;
+
+	if ( g_state.shader ) program = &((shaderdata_t*) g_state.shader)->base;
+	else if ( g_state.texture == 0 ) program = &g_batch.programs[PROGRAM_UNTEXTURED];
+	else if ( g_state.alpha_texture ) program = &g_batch.programs[PROGRAM_ALPHA];
+	else program = &g_batch.programs[PROGRAM_TEXTURED];
+
+	bind(program, model);
+}
+
+//particles have their own instanced vertex layout so user shaders don't apply to them
+void bind_particle_program(void)
+{
+	bind(&g_batch.programs[g_state.texture ? PROGRAM_PARTICLE : PROGRAM_PARTICLE_UNTEXTURED], NULL);
+}
+
+void flush_batch(flushreason_t reason)
+{
+	if ( g_batch.num_quads == 0 ) return;
+
+	g_frame_stats.flushes[reason]++;
+	g_frame_stats.draw_calls++;
+	g_frame_stats.vertices += g_batch.num_quads * 4;
+	g_frame_stats.indices += g_batch.num_quads * 6;
+	g_frame_stats.bytes_uploaded += sizeof(colorvertex_t) * 4 * g_batch.num_quads;
+
+	bind_program(NULL);
+	gl_bind_vertex_array(g_batch.vao);
+	gl_bind_buffer(GL_ARRAY_BUFFER, g_batch.vbo);
+
+	//orphan the previous contents so the driver doesn't wait on draws still using them
+	glBufferData(GL_ARRAY_BUFFER, sizeof(colorvertex_t) * 4 * MAX_BATCH_QUADS, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(colorvertex_t) * 4 * g_batch.num_quads, g_batch.vertices);
+	glDrawElements(GL_TRIANGLES, g_batch.num_quads * 6, GL_UNSIGNED_SHORT, 0);
+
+	g_batch.num_quads = 0;
+}
+
+static bool init_batch(void)
+{
+	unsigned short* indices;
+	int i;
+
+	if ( !init_builtin_programs(g_batch.programs) ) return false;
+
+	g_batch.vertices = (colorvertex_t*) mem_alloc(sizeof(colorvertex_t) * 4 * MAX_BATCH_QUADS, MEMORY_GEOMETRY);
+	g_batch.num_quads = 0;
+	g_batch.projection_serial = 0;
+	g_batch.model_serial = 0;
+	memset(g_batch.model, 0, sizeof(float) * 16);
+	g_batch.model[0] = g_batch.model[5] = g_batch.model[10] = g_batch.model[15] = 1.f;
+
+	indices = (unsigned short*) temp_alloc(sizeof(unsigned short) * 6 * MAX_BATCH_QUADS);
+	for (i=0; i<MAX_BATCH_QUADS; ++i)
+	{
+		indices[i*6+0] = (unsigned short) (i*4+0);
+		indices[i*6+1] = (unsigned short) (i*4+1);
+		indices[i*6+2] = (unsigned short) (i*4+2);
+		indices[i*6+3] = (unsigned short) (i*4+0);
+		indices[i*6+4] = (unsigned short) (i*4+2);
+		indices[i*6+5] = (unsigned short) (i*4+3);
+	}
+
+	glGenVertexArrays(1, &g_batch.vao);
+	gl_bind_vertex_array(g_batch.vao);
+
+	glGenBuffers(1, &g_batch.ibo);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, g_batch.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned short) * 6 * MAX_BATCH_QUADS, indices, GL_STATIC_DRAW);
+	temp_free(indices);
+
+	glGenBuffers(1, &g_batch.vbo);
+	gl_bind_buffer(GL_ARRAY_BUFFER, g_batch.vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(colorvertex_t) * 4 * MAX_BATCH_QUADS, NULL, GL_STREAM_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(colorvertex_t), (void*) 0);
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(colorvertex_t), (void*) (sizeof(float) * 2));
+	glEnableVertexAttribArray(2);
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(colorvertex_t), (void*) (sizeof(float) * 4));
+
+	return true;
+}
+
+bool gfx_compat(void)
+{
+	return g_compat;
+}
+
+static void free_batch(void)
+{
+	gl_delete_buffer(g_batch.vbo);
+	gl_delete_buffer(g_batch.ibo);
+	gl_delete_vertex_array(g_batch.vao);
+	free_builtin_programs(g_batch.programs);
+	mem_free(g_batch.vertices);
+	memset(&g_batch, 0, sizeof(batch_t));
+}
 
 static fontdata_t* alloc_font()
 {
-	fontdata_t* alloc = (fontdata_t*) malloc( sizeof(fontdata_t) );
+	fontdata_t* alloc = (fontdata_t*) mem_alloc(sizeof(fontdata_t), MEMORY_FONT);
 	memset(alloc, 0, sizeof(fontdata_t));
 	if ( g_fonts != NULL )
 	{
@@ -39,15 +268,26 @@ static fontdata_t* alloc_font()
 	return alloc;
 }
 
+static void release_face(fontface_t* face);
+
+static void destroy_font(fontdata_t* font)
+{
+	release_face(font->face);
+	mem_free(font->characters);
+	mem_free(font);
+}
+
 static void free_font(fontdata_t* font)
 {
 	if ( font == NULL ) return;
 
+	_free_texture(font->texture);
+
 	fontdata_t* ptr = g_fonts;
 	if ( ptr == font )
 	{
 		g_fonts = font->next;
-		free(font);
+		destroy_font(font);
 		return;
 	}
 
@@ -55,76 +295,415 @@ static void free_font(fontdata_t* font)
 	if ( ptr->next != font ) return;
 
 	ptr->next = font->next;
-	free(font);
+	destroy_font(font);
 }
 
-texture_t _load_texture(const char* filename)
+//decoding touches no GL state so it can run on any thread, pixels go to upload_texture
+void* decode_texture(const char* filename, int* width, int* height)
 {
-	int width;
-	int height;
 	int channels;
+	int size;
+	const void* packed = pack_find(filename, &size);
+	void* data;
 
-	void* data = stbi_load(filename, &width, &height, &channels, 4);
+	//archived files decode straight out of the mapping
+	if ( packed ) data = stbi_load_from_memory((const stbi_uc*) packed, size, width, height, &channels, 4);
+	else data = stbi_load(filename, width, height, &channels, 4);
 
 	if ( data != NULL )
 	{
-		printf("LOAD %s : %ix%i : %i\n", filename, width, height, channels);
+		printf("LOAD %s : %ix%i : %i\n", filename, *width, *height, channels);
 	}
 
+	return data;
+}
+
+void free_pixels(void* pixels)
+{
+	stbi_image_free(pixels);
+}
+
+//replaces the contents and size of a texture, takes ownership of pixels
+void fill_texture(texture_t texture, void* pixels, int width, int height)
+{
+	gl_bind_texture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	g_frame_stats.bytes_uploaded += width * height * 4;
+
+	free_pixels(pixels);
+}
+
+//takes ownership of pixels
+texture_t upload_texture(void* pixels, int width, int height)
+{
 	GLuint texture;
+
+	flush_batch(FLUSH_RESOURCE);
+
 	glGenTextures(1, &texture);
-	glBindTexture(GL_TEXTURE_2D, texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
+	gl_bind_texture(0, texture);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	track_texture(texture, width, height, 4, pixels);
+	fill_texture(texture, pixels, width, height);
 
-	stbi_image_free(data);
+	return texture;
+}
 
+texture_t _load_texture(const char* filename)
+{
+	int width = 0;
+	int height = 0;
+	void* data;
+	texture_t texture = take_preloaded_texture(filename);
+
+	if ( texture == 0 )
+	{
+		data = decode_texture(filename, &width, &height);
+		texture = upload_texture(data, width, height);
+		if ( data == NULL ) return texture;
+	}
+
+	set_texture_source(texture, filename);
 	return texture;
 }
 
-font_t _load_font(const char* filename)
+//adopt hands the allocator's buffer to the library, it's freed once decoded
+texture_t _load_texture_memory(const void* buffer, int size, bool adopt)
 {
-	FILE* fp;
-	unsigned char *ttf_buffer;
-	unsigned char bitmap[512*512];
-	fontdata_t* data;
+	int width, height, channels;
+	void* data = stbi_load_from_memory((const stbi_uc*) buffer, size, &width, &height, &channels, 4);
 
-	fp = fopen(filename, "rb");
-	if ( !fp ) 
+	if ( adopt ) free_adopted((void*) buffer);
+
+	if ( data == NULL )
+	{
+		printf("CAN'T DECODE TEXTURE %i BYTES\n", size);
+		return 0;
+	}
+
+	return upload_texture(data, width, height);
+}
+
+struct bakedfont_s
+{
+	stbtt_packedchar* characters;
+	int first_char;
+	int num_chars;
+	bool snap;
+	bool pixelated;
+	int width;
+	int height;
+	unsigned char* bitmap;
+	fontface_t* face;
+};
+
+static unsigned char* read_font_file(const char* filename)
+{
+	FILE* fp = fopen(filename, "rb");
+	unsigned char* data;
+	long size;
+
+	if ( !fp )
 	{
 		printf("CAN'T FIND %s\n", filename);
 		return NULL;
 	}
 
-	data = alloc_font();
-	data->width = 512;
-	data->height = 512;
-
 	printf("LOAD %s\n", filename);
 
-	ttf_buffer = (unsigned char*) malloc(0x100000);
-
-	fread(ttf_buffer, 1, 1<<20, fp);
-	stbtt_BakeFontBitmap(ttf_buffer, 0, 24.0, bitmap, data->width, data->height, 32, 96, data->characters);
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
 
+	data = (unsigned char*) mem_alloc(size, MEMORY_FONT);
+	fread(data, 1, size, fp);
 	fclose(fp);
-	free(ttf_buffer);
 
+	return data;
+}
+
+static fontface_t* find_face(const char* filename)
+{
+	fontface_t* face;
+	for (face = g_faces; face; face = face->next)
+	{
+		if ( strcmp(face->filename, filename) == 0 ) return face;
+	}
+	return NULL;
+}
+
+static void destroy_face(fontface_t* face)
+{
+	mem_free(face->data);
+	mem_free(face->filename);
+	mem_free(face);
+}
+
+//the file stays in memory while any size of it is loaded
+static fontface_t* acquire_face(const char* filename)
+{
+	fontface_t* face;
+	fontface_t* existing;
+	int packed_size = 0;
+	const unsigned char* ttf;
+	size_t length;
+
+	mutex_lock(g_face_lock);
+	face = find_face(filename);
+	if ( face ) face->refs++;
+	mutex_unlock(g_face_lock);
+	if ( face ) return face;
+
+	face = (fontface_t*) mem_calloc(1, sizeof(fontface_t), MEMORY_FONT);
+	ttf = (const unsigned char*) pack_find(filename, &packed_size);
+	if ( ttf == NULL ) ttf = face->data = read_font_file(filename);
+
+	if ( ttf == NULL || !stbtt_InitFont(&face->info, ttf, stbtt_GetFontOffsetForIndex(ttf, 0)) )
+	{
+		if ( ttf ) printf("CAN'T DECODE FONT %s\n", filename);
+		destroy_face(face);
+		return NULL;
+	}
+
+	length = strlen(filename) + 1;
+	face->filename = (char*) mem_alloc(length, MEMORY_FONT);
+	memcpy(face->filename, filename, length);
+	face->refs = 1;
+
+	//another thread may have read the same file meanwhile, the first one stays
+	mutex_lock(g_face_lock);
+	existing = find_face(filename);
+	if ( existing )
+	{
+		existing->refs++;
+	}
+	else
+	{
+		face->next = g_faces;
+		g_faces = face;
+	}
+	mutex_unlock(g_face_lock);
+
+	if ( existing ) destroy_face(face);
+	return existing ? existing : face;
+}
+
+static void release_face(fontface_t* face)
+{
+	fontface_t** ptr;
+	if ( face == NULL ) return;
+
+	mutex_lock(g_face_lock);
+	if ( --face->refs > 0 )
+	{
+		mutex_unlock(g_face_lock);
+		return;
+	}
+
+	for (ptr = &g_faces; *ptr != face; ptr = &(*ptr)->next);
+	*ptr = face->next;
+	mutex_unlock(g_face_lock);
+
+	destroy_face(face);
+}
+
+static bool rects_packed(const stbrp_rect* rects, int num_rects)
+{
+	int i;
+	for (i=0; i<num_rects; ++i)
+	{
+		if ( !rects[i].was_packed ) return false;
+	}
+	return true;
+}
+
+//rasterizes the glyphs without touching GL state, finished by upload_font. the glyph boxes are
+//measured first and the atlas is the smallest power of two they pack into
+static bakedfont_t* pack_font(const stbtt_fontinfo* info, int pixel_size, const fontoptions_t* options)
+{
+	stbtt_pack_context pack;
+	stbtt_pack_range range;
+	stbrp_rect* rects;
+	bakedfont_t* baked;
+	int oversample = options && options->oversample > 0 ? options->oversample : DEFAULT_OVERSAMPLE;
+	int num_rects;
+	long long area = 0;
+	int i;
+
+	if ( oversample > STBTT_MAX_OVERSAMPLE ) oversample = STBTT_MAX_OVERSAMPLE;
+
+	baked = (bakedfont_t*) mem_calloc(1, sizeof(bakedfont_t), MEMORY_FONT);
+	baked->first_char = options && options->num_chars > 0 ? options->first_char : 32;
+	baked->num_chars = options && options->num_chars > 0 ? options->num_chars : 96;
+	baked->snap = oversample == 1;
+	baked->pixelated = options && options->pixelated;
+	baked->characters = (stbtt_packedchar*) mem_calloc(baked->num_chars, sizeof(stbtt_packedchar), MEMORY_FONT);
+
+	memset(&range, 0, sizeof(range));
+	range.font_size = (float) (pixel_size > 0 ? pixel_size : DEFAULT_FONT_SIZE);
+	range.first_unicode_codepoint_in_range = baked->first_char;
+	range.num_chars = baked->num_chars;
+	range.chardata_for_range = baked->characters;
+
+	rects = (stbrp_rect*) temp_alloc(sizeof(stbrp_rect) * baked->num_chars);
+
+	stbtt_PackBegin(&pack, NULL, MAX_ATLAS_SIZE, MAX_ATLAS_SIZE, 0, 1, NULL);
+	stbtt_PackSetOversampling(&pack, oversample, 1);
+	num_rects = stbtt_PackFontRangesGatherRects(&pack, info, &range, 1, rects);
+	stbtt_PackEnd(&pack);
+
+	//packing never reaches full coverage, start with a quarter spare
+	for (i=0; i<num_rects; ++i) area += rects[i].w * rects[i].h;
+	area += area / 4;
+
+	baked->width = baked->height = 64;
+	while ( (long long) baked->width * baked->height < area )
+	{
+		if ( baked->width > baked->height ) baked->height *= 2;
+		else baked->width *= 2;
+	}
+
+	//same steps as stbtt_PackFontRanges, split so the parsed face is reused and a failed
+	//pack retries larger without rasterizing
+	for (;;)
+	{
+		baked->bitmap = (unsigned char*) temp_alloc(baked->width * baked->height);
+		stbtt_PackBegin(&pack, baked->bitmap, baked->width, baked->height, 0, 1, NULL);
+		stbtt_PackSetOversampling(&pack, oversample, 1);
+		stbtt_PackFontRangesPackRects(&pack, rects, num_rects);
+
+		if ( rects_packed(rects, num_rects) )
+		{
+			stbtt_PackFontRangesRenderIntoRects(&pack, info, &range, 1, rects);
+			stbtt_PackEnd(&pack);
+			break;
+		}
+
+		stbtt_PackEnd(&pack);
+		temp_free(baked->bitmap);
+		baked->bitmap = NULL;
+
+		if ( baked->width >= MAX_ATLAS_SIZE && baked->height >= MAX_ATLAS_SIZE )
+		{
+			printf("CAN'T FIT %i GLYPHS AT %gPX\n", baked->num_chars, range.font_size);
+			break;
+		}
+
+		if ( baked->width > baked->height ) baked->height *= 2;
+		else baked->width *= 2;
+	}
+
+	temp_free(rects);
+
+	if ( baked->bitmap == NULL )
+	{
+		mem_free(baked->characters);
+		mem_free(baked);
+		return NULL;
+	}
+
+	return baked;
+}
+
+//stb_truetype only reads the font so it's used in place
+static bakedfont_t* bake_font_memory(const unsigned char* ttf)
+{
+	stbtt_fontinfo info;
+	int offset = stbtt_GetFontOffsetForIndex(ttf, 0);
+
+	if ( offset < 0 || !stbtt_InitFont(&info, ttf, offset) ) return NULL;
+	return pack_font(&info, DEFAULT_FONT_SIZE, NULL);
+}
+
+bakedfont_t* bake_font(const char* filename, int pixel_size, const fontoptions_t* options)
+{
+	fontface_t* face = acquire_face(filename);
+	bakedfont_t* baked;
+
+	if ( face == NULL ) return NULL;
+
+	baked = pack_font(&face->info, pixel_size, options);
+	if ( baked == NULL )
+	{
+		release_face(face);
+		return NULL;
+	}
+
+	baked->face = face;
+	return baked;
+}
+
+//takes ownership of baked
+font_t upload_font(bakedfont_t* baked)
+{
+	fontdata_t* data;
+	if ( baked == NULL ) return NULL;
+
+	data = alloc_font();
+	data->characters = baked->characters;
+	data->first_char = baked->first_char;
+	data->num_chars = baked->num_chars;
+	data->snap = baked->snap;
+	data->width = baked->width;
+	data->height = baked->height;
+	data->face = baked->face;
+
+	flush_batch(FLUSH_RESOURCE);
+
+	//core profile has no GL_ALPHA, the alpha program reads the red channel instead
 	glGenTextures(1, &data->texture);
-	glBindTexture(GL_TEXTURE_2D, data->texture);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, data->width, data->height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, bitmap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gl_bind_texture(0, data->texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	if ( g_compat ) glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, data->width, data->height, 0, GL_ALPHA, GL_UNSIGNED_BYTE, baked->bitmap);
+	else glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, data->width, data->height, 0, GL_RED, GL_UNSIGNED_BYTE, baked->bitmap);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	g_frame_stats.bytes_uploaded += data->width * data->height;
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, baked->pixelated ? GL_NEAREST : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, baked->pixelated ? GL_NEAREST : GL_LINEAR);
+	track_texture(data->texture, data->width, data->height, 1, NULL);
+
+	temp_free(baked->bitmap);
+	mem_free(baked);
 
 	return data;
 }
 
+font_t _load_font_memory(const void* buffer, int size, bool adopt)
+{
+	bakedfont_t* baked = size > 0 ? bake_font_memory((const unsigned char*) buffer) : NULL;
+
+	if ( adopt ) free_adopted((void*) buffer);
+
+	if ( baked == NULL )
+	{
+		printf("CAN'T DECODE FONT %i BYTES\n", size);
+		return NULL;
+	}
+
+	return upload_font(baked);
+}
+
+font_t _load_font(const char* filename)
+{
+	font_t font = take_preloaded_font(filename);
+	if ( font ) return font;
+
+	return upload_font( bake_font(filename, DEFAULT_FONT_SIZE, NULL) );
+}
+
+font_t _load_font_ex(const char* filename, int pixel_size, const fontoptions_t* options)
+{
+	return upload_font( bake_font(filename, pixel_size, options) );
+}
+
 void _free_texture(texture_t texture)
 {
-	glDeleteTextures(1, &texture);
+	flush_batch(FLUSH_RESOURCE);
+	if ( texture == g_state.texture ) g_state.texture = 0;
+	forget_dynamic_texture(texture);
+	untrack_texture(texture);
+	gl_delete_texture(texture);
 }
 
 void _free_font(font_t font) 
@@ -132,28 +711,192 @@ void _free_font(font_t font)
 	free_font( (fontdata_t*) font );
 }
 
+static char* read_text_file(const char* filename)
+{
+	FILE* fp;
+	char* text;
+	long size;
+	int packed_size;
+	const void* packed = pack_find(filename, &packed_size);
+
+	if ( packed )
+	{
+		text = (char*) temp_alloc(packed_size + 1);
+		memcpy(text, packed, packed_size);
+		text[packed_size] = 0;
+		return text;
+	}
+
+	fp = fopen(filename, "rb");
+
+	if ( !fp )
+	{
+		printf("CAN'T FIND %s\n", filename);
+		return NULL;
+	}
+
+	fseek(fp, 0, SEEK_END);
+	size = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	text = (char*) temp_alloc(size + 1);
+	text[fread(text, 1, size, fp)] = 0;
+	fclose(fp);
+	return text;
+}
+
+shader_t _create_shader(const char* vertex_source, const char* fragment_source)
+{
+	if ( g_compat )
+	{
+		printf("SHADERS REQUIRE THE CORE PROFILE RENDERER\n");
+		return NULL;
+	}
+
+	if ( fragment_source == NULL ) return NULL;
+
+	return create_user_shader(vertex_source, fragment_source);
+}
+
+shader_t _load_shader(const char* vertex_filename, const char* fragment_filename)
+{
+	char* vertex_source = NULL;
+	char* fragment_source = NULL;
+	shader_t shader = NULL;
+
+	if ( vertex_filename ) vertex_source = read_text_file(vertex_filename);
+	fragment_source = read_text_file(fragment_filename);
+
+	if ( fragment_source && (vertex_source || !vertex_filename) )
+	{
+		printf("LOAD %s\n", fragment_filename);
+		shader = _create_shader(vertex_source, fragment_source);
+	}
+
+	temp_free(vertex_source);
+	temp_free(fragment_source);
+	return shader;
+}
+
+void _free_shader(shader_t shader)
+{
+	if ( shader == NULL ) return;
+
+	flush_batch(FLUSH_RESOURCE);
+	if ( shader == g_state.shader ) g_state.shader = NULL;
+	free_user_shader( (shaderdata_t*) shader );
+}
+
+void _set_shader(shader_t shader)
+{
+	if ( shader == g_state.shader ) return;
+	flush_batch(FLUSH_SHADER);
+	g_state.shader = shader;
+}
+
+//uploads to the current shader, skipping values that are already there
+void set_uniform(const char* name, const uniformvalue_t* value)
+{
+	shaderdata_t* shader = (shaderdata_t*) g_state.shader;
+	uniformslot_t* slot;
+	int count = 1;
+
+	if ( shader == NULL ) return;
+
+	slot = find_uniform(shader, name);
+	if ( slot->location < 0 ) return;
+
+	if ( value->type == UNIFORM_VEC2 ) count = 2;
+	if ( value->type == UNIFORM_VEC4 ) count = 4;
+
+	if ( slot->set && slot->value.type == value->type )
+	{
+		if ( value->type == UNIFORM_INT && slot->value.data.i == value->data.i ) return;
+		if ( value->type != UNIFORM_INT && memcmp(slot->value.data.f, value->data.f, sizeof(float) * count) == 0 ) return;
+	}
+
+	//pending quads were drawn with the old value
+	flush_batch(FLUSH_SHADER);
+	slot->set = true;
+	slot->value = *value;
+
+	gl_use_program(shader->base.program);
+	switch( value->type )
+	{
+		case UNIFORM_INT: glUniform1i(slot->location, value->data.i); break;
+		case UNIFORM_FLOAT: glUniform1fv(slot->location, 1, value->data.f); break;
+		case UNIFORM_VEC2: glUniform2fv(slot->location, 1, value->data.f); break;
+		case UNIFORM_VEC4: glUniform4fv(slot->location, 1, value->data.f); break;
+	}
+}
+
+void _set_uniform_int(const char* name, int x)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_INT;
+	value.data.i = x;
+	set_uniform(name, &value);
+}
+
+void _set_uniform_float(const char* name, float x)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_FLOAT;
+	value.data.f[0] = x;
+	set_uniform(name, &value);
+}
+
+void _set_uniform_vec2(const char* name, float x, float y)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_VEC2;
+	value.data.f[0] = x;
+	value.data.f[1] = y;
+	set_uniform(name, &value);
+}
+
+void _set_uniform_vec4(const char* name, float x, float y, float z, float w)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_VEC4;
+	value.data.f[0] = x;
+	value.data.f[1] = y;
+	value.data.f[2] = z;
+	value.data.f[3] = w;
+	set_uniform(name, &value);
+}
+
 void _set_blend(blend_t blend)
 {
-	if ( blend = g_state.blend ) return;
+	if ( blend == g_state.blend ) return;
+	flush_batch(FLUSH_BLEND);
 	g_state.blend = blend;
 
 	switch( blend )
 	{
 		case BLEND_ALPHA:
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 		break;
 		case BLEND_ADD:
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		gl_blend_func(GL_SRC_ALPHA, GL_ONE);
 		break;
 	}
 }
 
 void _set_texture(texture_t texture) 
 {
-	if ( texture == g_state.texture ) return;
+	if ( texture == g_state.texture && !g_state.alpha_texture ) return;
+	flush_batch(FLUSH_TEXTURE);
 	g_state.texture = texture;
+	g_state.alpha_texture = false;
+}
 
-	glBindTexture(GL_TEXTURE_2D, texture);
+void set_font_texture(texture_t texture)
+{
+	if ( texture == g_state.texture && g_state.alpha_texture ) return;
+	flush_batch(FLUSH_TEXTURE);
+	g_state.texture = texture;
+	g_state.alpha_texture = true;
 }
 
 void _set_color(color_t color) 
@@ -161,24 +904,28 @@ void _set_color(color_t color)
 	if ( color == g_state.color ) return;
 	g_state.color = color;
 
-	glColor4ubv((GLubyte*)&g_state.color);
+	//vertices carry their color, so this never breaks a batch
+	if ( g_compat ) glColor4ubv((GLubyte*)&g_state.color);
 }
 
-void _draw_rect(float x, float y, float width, float height) 
+static void put_vertex(colorvertex_t* out, float x, float y, float u, float v, color_t color)
 {
-	glBegin(GL_QUADS);
-	glTexCoord2f(0,0);
-	glVertex2f(x,y);
-	glTexCoord2f(1,0);
-	glVertex2f(x+width,y);
-	glTexCoord2f(1,1);
-	glVertex2f(x+width,y+height);
-	glTexCoord2f(0,1);
-	glVertex2f(x,y+height);
-	glEnd();
+	out->x = x;
+	out->y = y;
+	out->u = u;
+	out->v = v;
+	out->color = color;
 }
 
-void _draw_sprite(float x, float y, float width, float height, float rotation) 
+void build_rect(colorvertex_t* out, float x, float y, float width, float height, color_t color)
+{
+	put_vertex(out+0, x, y, 0, 0, color);
+	put_vertex(out+1, x + width, y, 1, 0, color);
+	put_vertex(out+2, x + width, y + height, 1, 1, color);
+	put_vertex(out+3, x, y + height, 0, 1, color);
+}
+
+void build_sprite(colorvertex_t* out, float x, float y, float width, float height, float rotation, color_t color)
 {
 	float c = cosf(rotation);
 	float s = sinf(rotation);
@@ -187,70 +934,454 @@ void _draw_sprite(float x, float y, float width, float height, float rotation)
 	float ch = c * height * .5f;
 	float sh = s * height * .5f;
 
-	glBegin(GL_QUADS);
-	glTexCoord2f(0,0);
-	glVertex2f(x - cw - sh, y + sw - ch);
-	glTexCoord2f(1,0);
-	glVertex2f(x + cw - sh, y - sw - ch);
-	glTexCoord2f(1,1);
-	glVertex2f(x + cw + sh, y - sw + ch);
-	glTexCoord2f(0,1);
-	glVertex2f(x - cw + sh, y + sw + ch);
-	glEnd();
+	put_vertex(out+0, x - cw - sh, y + sw - ch, 0, 0, color);
+	put_vertex(out+1, x + cw - sh, y - sw - ch, 1, 0, color);
+	put_vertex(out+2, x + cw + sh, y - sw + ch, 1, 1, color);
+	put_vertex(out+3, x - cw + sh, y + sw + ch, 0, 1, color);
 }
 
-void _draw_polygon(vertex_t* vertices, int num_vertices) 
+static bool has_glyph(const fontdata_t* data, char c)
+{
+	int index = (unsigned char) c - data->first_char;
+	return index >= 0 && index < data->num_chars;
+}
+
+int text_quad_count(font_t font, const char* text)
+{
+	int count = 0;
+	while ( *text )
+	{
+		if ( has_glyph((const fontdata_t*) font, *text) ) ++count;
+		++text;
+	}
+	return count;
+}
+
+static bool build_glyph(colorvertex_t* out, fontdata_t* data, char c, float* x, float* y, color_t color)
+{
+	stbtt_aligned_quad q;
+	if ( !has_glyph(data, c) ) return false;
+
+	stbtt_GetPackedQuad( data->characters, data->width, data->height, (unsigned char) c - data->first_char, x, y, &q, data->snap );
+	put_vertex(out+0, q.x0, q.y0, q.s0, q.t0, color);
+	put_vertex(out+1, q.x1, q.y0, q.s1, q.t0, color);
+	put_vertex(out+2, q.x1, q.y1, q.s1, q.t1, color);
+	put_vertex(out+3, q.x0, q.y1, q.s0, q.t1, color);
+	return true;
+}
+
+int build_text(colorvertex_t* out, font_t font, float x, float y, const char* text, color_t color)
+{
+	fontdata_t* data = (fontdata_t*) font;
+	int count = 0;
+
+	while ( *text )
+	{
+		if ( build_glyph(out + count * 4, data, *text, &x, &y, color) ) ++count;
+		++text;
+	}
+	return count;
+}
+
+texture_t font_texture(font_t font)
+{
+	return ((fontdata_t*) font)->texture;
+}
+
+texture_t current_texture(void)
+{
+	return g_state.texture;
+}
+
+//stamp replaces the vertex colors with the current set_color color
+void emit_vertices(const colorvertex_t* vertices, int num_vertices, bool stamp)
 {
 	int i;
+
+	//only font atlases bind as alpha textures, so these quads are glyphs
+	if ( g_state.alpha_texture ) g_frame_stats.glyphs += num_vertices / 4;
+
+	if ( !g_compat )
+	{
+		int num_quads = num_vertices / 4;
+		while ( num_quads > 0 )
+		{
+			colorvertex_t* out = g_batch.vertices + g_batch.num_quads * 4;
+			int count = MAX_BATCH_QUADS - g_batch.num_quads;
+			if ( count > num_quads ) count = num_quads;
+
+			memcpy(out, vertices, sizeof(colorvertex_t) * 4 * count);
+			if ( stamp )
+			{
+				for (i=0; i<count*4; ++i) out[i].color = g_state.color;
+			}
+
+			g_batch.num_quads += count;
+			vertices += count * 4;
+			num_quads -= count;
+
+			if ( g_batch.num_quads == MAX_BATCH_QUADS ) flush_batch(FLUSH_FULL);
+		}
+		return;
+	}
+
+	apply_texture();
+	g_frame_stats.draw_calls++;
+	g_frame_stats.vertices += num_vertices;
+	g_frame_stats.bytes_uploaded += sizeof(colorvertex_t) * num_vertices;
 	glBegin(GL_QUADS);
 	for (i=0; i<num_vertices; ++i)
 	{
-		vertex_t* v = vertices + i;
+		const colorvertex_t* v = vertices + i;
+		glColor4ubv((GLubyte*) (stamp ? &g_state.color : &v->color));
 		glTexCoord2f(v->u, v->v);
 		glVertex2f(v->x, v->y);
 	}
 	glEnd();
 }
 
+void emit_quads(const vertex_t* vertices, int num_vertices)
+{
+	colorvertex_t chunk[256];
+	int i;
+
+	while ( num_vertices >= 4 )
+	{
+		int count = num_vertices < 256 ? num_vertices & ~3 : 256;
+		for (i=0; i<count; ++i)
+		{
+			put_vertex(chunk+i, vertices[i].x, vertices[i].y, vertices[i].u, vertices[i].v, g_state.color);
+		}
+		emit_vertices(chunk, count, false);
+		vertices += count;
+		num_vertices -= count;
+	}
+}
+
+void _draw_rect(float x, float y, float width, float height) 
+{
+	colorvertex_t quad[4];
+	if ( view_rejects(fminf(x, x + width), fminf(y, y + height), fmaxf(x, x + width), fmaxf(y, y + height)) ) return;
+
+	build_rect(quad, x, y, width, height, g_state.color);
+	emit_vertices(quad, 4, false);
+}
+
+void _draw_sprite(float x, float y, float width, float height, float rotation) 
+{
+	colorvertex_t quad[4];
+	float radius = sqrtf(width * width + height * height) * .5f;
+	if ( view_rejects(x - radius, y - radius, x + radius, y + radius) ) return;
+
+	build_sprite(quad, x, y, width, height, rotation, g_state.color);
+	emit_vertices(quad, 4, false);
+}
+
+void _draw_polygon(vertex_t* vertices, int num_vertices) 
+{
+	emit_quads(vertices, num_vertices);
+}
+
 void _draw_quad(vertex_t vertices[4]) 
 {
 	_draw_polygon( vertices, 4 );
 }
 
+void _draw_polygon_colored(colorvertex_t* vertices, int num_vertices) 
+{
+	emit_vertices(vertices, num_vertices, false);
+}
+
+void _draw_quad_colored(colorvertex_t vertices[4]) 
+{
+	_draw_polygon_colored( vertices, 4 );
+}
+
 void _draw_text(font_t font, float x, float y, const char* text) 
 {
-	fontdata_t* data = (fontdata_t*) font;
-	if ( data == NULL ) return;
+	colorvertex_t* quads;
+	texture_t saved;
+	int count;
+	if ( font == NULL ) return;
 
-	glBindTexture(GL_TEXTURE_2D, data->texture);
-	glBegin(GL_QUADS);
-	while ( *text )
+	count = text_quad_count(font, text);
+	if ( count == 0 ) return;
+
+	quads = (colorvertex_t*) temp_alloc(sizeof(colorvertex_t) * count * 4);
+	build_text(quads, font, x, y, text, g_state.color);
+
+	saved = g_state.texture;
+	set_font_texture(font_texture(font));
+	emit_vertices(quads, count * 4, false);
+	_set_texture(saved);
+
+	temp_free(quads);
+}
+
+static transform_t multiply_transform(const transform_t* a, const transform_t* b)
+{
+	transform_t t;
+	t.m[0] = a->m[0] * b->m[0] + a->m[2] * b->m[1];
+	t.m[1] = a->m[1] * b->m[0] + a->m[3] * b->m[1];
+	t.m[2] = a->m[0] * b->m[2] + a->m[2] * b->m[3];
+	t.m[3] = a->m[1] * b->m[2] + a->m[3] * b->m[3];
+	t.m[4] = a->m[0] * b->m[4] + a->m[2] * b->m[5] + a->m[4];
+	t.m[5] = a->m[1] * b->m[4] + a->m[3] * b->m[5] + a->m[5];
+	return t;
+}
+
+//world to screen, the camera position ends up in the middle of the view
+static transform_t view_transform(void)
+{
+	transform_t t;
+	const camera_t* camera = &g_view.camera;
+
+	if ( !g_view.has_camera ) return g_view.stack[g_view.depth];
+
+	t = TRANSFORM(g_view.width * .5f, g_view.height * .5f, -camera->rotation, camera->zoom);
+	t.m[4] -= t.m[0] * camera->x + t.m[2] * camera->y;
+	t.m[5] -= t.m[1] * camera->x + t.m[3] * camera->y;
+	return multiply_transform(&t, &g_view.stack[g_view.depth]);
+}
+
+static void update_view_bounds(const transform_t* t)
+{
+	float corners[8] = { 0,0, (float) g_view.width,0, 0,(float) g_view.height, (float) g_view.width,(float) g_view.height };
+	float det = t->m[0] * t->m[3] - t->m[2] * t->m[1];
+	int i;
+
+	if ( det == 0.f )
 	{
-		if ( *text >= 32 && *text < 128 )
-		{
-			stbtt_aligned_quad q;
-			stbtt_GetBakedQuad( data->characters, data->width, data->height, *text-32, &x, &y, &q, 1 );
-			glTexCoord2f(q.s0, q.t0);
-			glVertex2f(q.x0, q.y0);
-			glTexCoord2f(q.s1, q.t0);
-			glVertex2f(q.x1, q.y0);
-			glTexCoord2f(q.s1, q.t1);
-			glVertex2f(q.x1, q.y1);
-			glTexCoord2f(q.s0, q.t1);
-			glVertex2f(q.x0, q.y1);
-		}
-		++text;
+		g_view.bounds[0] = g_view.bounds[1] = 1.f;
+		g_view.bounds[2] = g_view.bounds[3] = -1.f;
+		return;
 	}
-	glEnd();
-	glBindTexture(GL_TEXTURE_2D, g_state.texture);
+
+	for (i=0; i<4; ++i)
+	{
+		float x = corners[i*2] - t->m[4];
+		float y = corners[i*2+1] - t->m[5];
+		float wx = ( t->m[3] * x - t->m[2] * y) / det;
+		float wy = (-t->m[1] * x + t->m[0] * y) / det;
+
+		if ( i == 0 || wx < g_view.bounds[0] ) g_view.bounds[0] = wx;
+		if ( i == 0 || wy < g_view.bounds[1] ) g_view.bounds[1] = wy;
+		if ( i == 0 || wx > g_view.bounds[2] ) g_view.bounds[2] = wx;
+		if ( i == 0 || wy > g_view.bounds[3] ) g_view.bounds[3] = wy;
+	}
+}
+
+//flip maps y up, render target textures are sampled bottom row first so this keeps
+//their contents upright when drawn back with draw_rect
+static void update_projection(void)
+{
+	transform_t t = view_transform();
+	float* m = g_batch.projection;
+	float sx = 2.f / g_view.width;
+	float sy = g_view.flip ? 2.f / g_view.height : -2.f / g_view.height;
+	float ty = g_view.flip ? -1.f : 1.f;
+
+	flush_batch(FLUSH_VIEW);
+	update_view_bounds(&t);
+
+	if ( g_compat )
+	{
+		float view[16] = { t.m[0],t.m[1],0,0, t.m[2],t.m[3],0,0, 0,0,1,0, t.m[4],t.m[5],0,1 };
+		glLoadIdentity();
+		if ( g_view.flip ) glOrtho(0,g_view.width,0,g_view.height,-1,1);
+		else glOrtho(0,g_view.width,g_view.height,0,-1,1);
+		glMultMatrixf(view);
+		return;
+	}
+
+	//glOrtho above times the view, column major
+	memset(m, 0, sizeof(float) * 16);
+	m[0] = sx * t.m[0];
+	m[1] = sy * t.m[1];
+	m[4] = sx * t.m[2];
+	m[5] = sy * t.m[3];
+	m[10] = -1.f;
+	m[12] = sx * t.m[4] - 1.f;
+	m[13] = sy * t.m[5] + ty;
+	m[15] = 1.f;
+	g_batch.projection_serial++;
+}
+
+static void apply_viewport(int width, int height, bool flip)
+{
+	flush_batch(FLUSH_VIEW);
+	gl_viewport(0, 0, width, height);
+
+	g_view.width = width;
+	g_view.height = height;
+	g_view.flip = flip;
+	update_projection();
+}
+
+void set_viewport(int width, int height)
+{
+	g_window_width = width;
+	g_window_height = height;
+
+	//a bound render target keeps its own projection until it's released
+	if ( g_target ) return;
+	apply_viewport(width, height, false);
+}
+
+//the visible area in the current drawing coordinates
+void get_view_rect(float* x0, float* y0, float* x1, float* y1)
+{
+	*x0 = g_view.bounds[0];
+	*y0 = g_view.bounds[1];
+	*x1 = g_view.bounds[2];
+	*y1 = g_view.bounds[3];
+}
+
+void _set_camera(const camera_t* camera)
+{
+	if ( camera == NULL && !g_view.has_camera ) return;
+
+	g_view.has_camera = camera != NULL;
+	if ( camera ) g_view.camera = *camera;
+	update_projection();
+}
+
+void _push_transform(const transform_t* transform)
+{
+	if ( g_view.depth == MAX_TRANSFORMS - 1 )
+	{
+		printf("TRANSFORM STACK OVERFLOW\n");
+		return;
+	}
+
+	g_view.stack[g_view.depth + 1] = multiply_transform(&g_view.stack[g_view.depth], transform);
+	g_view.depth++;
+	update_projection();
+}
+
+void _pop_transform(void)
+{
+	if ( g_view.depth == 0 ) return;
+	g_view.depth--;
+	update_projection();
+}
+
+rendertarget_t _create_render_target(int width, int height)
+{
+	rendertargetdata_t* target;
+	GLenum status;
+
+	flush_batch(FLUSH_RESOURCE);
+
+	target = (rendertargetdata_t*) mem_alloc(sizeof(rendertargetdata_t), MEMORY_GENERAL);
+	memset(target, 0, sizeof(rendertargetdata_t));
+	target->width = width;
+	target->height = height;
+
+	glGenTextures(1, &target->texture);
+	gl_bind_texture(0, target->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glGenFramebuffers(1, &target->framebuffer);
+	gl_bind_framebuffer(target->framebuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->texture, 0);
+	status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+
+	//start out transparent
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	gl_bind_framebuffer(g_target ? g_target->framebuffer : 0);
+
+	if ( status != GL_FRAMEBUFFER_COMPLETE )
+	{
+		printf("RENDER TARGET %ix%i INCOMPLETE : %x\n", width, height, status);
+		gl_delete_framebuffer(target->framebuffer);
+		gl_delete_texture(target->texture);
+		mem_free(target);
+		return NULL;
+	}
+
+	track_texture(target->texture, width, height, 4, NULL);
+	return target;
+}
+
+void _set_render_target(rendertarget_t target)
+{
+	rendertargetdata_t* data = (rendertargetdata_t*) target;
+	if ( data == g_target ) return;
+
+	flush_batch(FLUSH_TARGET);
+	g_target = data;
+
+	if ( data )
+	{
+		gl_bind_framebuffer(data->framebuffer);
+		apply_viewport(data->width, data->height, true);
+	}
+	else
+	{
+		gl_bind_framebuffer(0);
+		apply_viewport(g_window_width, g_window_height, false);
+	}
+}
+
+void _free_render_target(rendertarget_t target)
+{
+	rendertargetdata_t* data = (rendertargetdata_t*) target;
+	if ( data == NULL ) return;
+
+	if ( data == g_target ) _set_render_target(NULL);
+	_free_texture(data->texture);
+	gl_delete_framebuffer(data->framebuffer);
+	mem_free(data);
+}
+
+texture_t _get_render_target_texture(rendertarget_t target)
+{
+	return target ? ((rendertargetdata_t*) target)->texture : 0;
 }
 
-void init_gfx_lib(libgfx_t* gfx)
+void _clear(color_t color)
+{
+	flush_batch(FLUSH_TARGET);
+	glClearColor(
+		(color & 0xFF) / 255.f,
+		((color >> 8) & 0xFF) / 255.f,
+		((color >> 16) & 0xFF) / 255.f,
+		((color >> 24) & 0xFF) / 255.f);
+	glClear(GL_COLOR_BUFFER_BIT);
+}
+
+void clear_frame(void)
+{
+	glClearColor(.1f, .15f, .3f, 1.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void end_frame(void)
+{
+	flush_batch(FLUSH_FRAME);
+	_set_render_target(NULL);
+	update_texture_cache();
+	end_gl_state_frame();
+	end_stats_frame();
+}
+
+bool init_gfx_lib(libgfx_t* gfx, bool compat, int texture_budget)
 {
 	gfx->load_texture = _load_texture;
 	gfx->load_font = _load_font;
+	gfx->load_font_ex = _load_font_ex;
+	gfx->load_texture_memory = _load_texture_memory;
+	gfx->load_font_memory = _load_font_memory;
 	gfx->free_texture = _free_texture;
 	gfx->free_font = _free_font;
+	gfx->create_texture = _create_texture;
+	gfx->update_texture = _update_texture;
 
 	gfx->set_blend = _set_blend;
 	gfx->set_texture = _set_texture;
@@ -261,18 +1392,103 @@ void init_gfx_lib(libgfx_t* gfx)
 	gfx->draw_quad = _draw_quad;
 	gfx->draw_polygon = _draw_polygon;
 	gfx->draw_text = _draw_text;
+	gfx->draw_quad_colored = _draw_quad_colored;
+	gfx->draw_polygon_colored = _draw_polygon_colored;
+
+	gfx->load_shader = _load_shader;
+	gfx->create_shader = _create_shader;
+	gfx->free_shader = _free_shader;
+	gfx->set_shader = _set_shader;
+	gfx->set_uniform_int = _set_uniform_int;
+	gfx->set_uniform_float = _set_uniform_float;
+	gfx->set_uniform_vec2 = _set_uniform_vec2;
+	gfx->set_uniform_vec4 = _set_uniform_vec4;
 
+	gfx->create_render_target = _create_render_target;
+	gfx->free_render_target = _free_render_target;
+	gfx->set_render_target = _set_render_target;
+	gfx->get_render_target_texture = _get_render_target_texture;
+	gfx->clear = _clear;
+
+	gfx->create_mesh = _create_mesh;
+	gfx->free_mesh = _free_mesh;
+	gfx->draw_mesh = _draw_mesh;
+
+	gfx->set_camera = _set_camera;
+	gfx->push_transform = _push_transform;
+	gfx->pop_transform = _pop_transform;
+
+	gfx->create_particles = _create_particles;
+	gfx->free_particles = _free_particles;
+	gfx->emit_particles = _emit_particles;
+	gfx->update_particles = _update_particles;
+	gfx->draw_particles = _draw_particles;
+	gfx->particle_count = _particle_count;
+
+	gfx->create_tilemap = _create_tilemap;
+	gfx->free_tilemap = _free_tilemap;
+	gfx->set_tile = _set_tile;
+	gfx->get_tile = _get_tile;
+	gfx->draw_tilemap = _draw_tilemap;
+
+	gfx->get_state_calls = _get_state_calls;
+	gfx->get_render_stats = _get_render_stats;
+
+	init_drawlist_lib(gfx);
+
+	g_compat = compat;
 	g_state.color = 0xFFFFFFFF;
 	g_state.blend = BLEND_ALPHA;
 	g_state.texture = 0;
+	g_state.alpha_texture = false;
+	g_state.shader = NULL;
+
+	memset(&g_view, 0, sizeof(view_t));
+	g_view.stack[0] = TRANSFORM(0.f, 0.f, 0.f, 1.f);
 
-	glEnable(GL_TEXTURE_2D);
+	reset_gl_state();
+	init_stats();
+	init_texture_cache(texture_budget);
 	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glColor4ubv((GLubyte*)&g_state.color);
+	gl_blend_equation(GL_FUNC_ADD);
+	gl_blend_func(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	gl_scissor(false, 0, 0, 0, 0);
+
+	if ( g_compat )
+	{
+		glEnable(GL_TEXTURE_2D);
+		glColor4ubv((GLubyte*)&g_state.color);
+		return true;
+	}
+
+	return init_batch();
 }
 
-void shutdown_gfx_lib()
+//faces outlive the gfx lib on both ends, preloading bakes fonts before the context exists
+void init_font_cache(void)
+{
+	g_face_lock = mutex_create();
+}
+
+void shutdown_font_cache(void)
 {
+	fontface_t* next;
 
+	while ( g_faces )
+	{
+		next = g_faces->next;
+		destroy_face(g_faces);
+		g_faces = next;
+	}
+
+	mutex_free(g_face_lock);
+	g_face_lock = NULL;
+}
+
+void shutdown_gfx_lib()
+{
+	free_texture_streams();
+	shutdown_texture_cache();
+	shutdown_stats();
+	if ( !g_compat ) free_batch();
 }
\ No newline at end of file
@@ -1,4 +1,130 @@
 #include "lib.h"
+#include "shader.h"
 
-extern void init_gfx_lib(libgfx_t* gfx);
-extern void shutdown_gfx_lib();
\ No newline at end of file
+extern bool init_gfx_lib(libgfx_t* gfx, bool compat, int texture_budget);
+extern void shutdown_gfx_lib();
+extern void init_font_cache(void);
+extern void shutdown_font_cache(void);
+
+//geometry builders shared by immediate drawing and draw lists
+extern void build_rect(colorvertex_t* out, float x, float y, float width, float height, color_t color);
+extern void build_sprite(colorvertex_t* out, float x, float y, float width, float height, float rotation, color_t color);
+extern int build_text(colorvertex_t* out, font_t font, float x, float y, const char* text, color_t color);
+extern int text_quad_count(font_t font, const char* text);
+extern texture_t font_texture(font_t font);
+extern texture_t current_texture(void);
+extern void emit_quads(const vertex_t* vertices, int num_vertices);
+extern void emit_vertices(const colorvertex_t* vertices, int num_vertices, bool stamp);
+
+extern void set_viewport(int width, int height);
+extern void clear_frame(void);
+extern void end_frame(void);
+
+typedef struct bakedfont_s bakedfont_t;
+extern void* decode_texture(const char* filename, int* width, int* height);
+extern texture_t upload_texture(void* pixels, int width, int height);
+extern void fill_texture(texture_t texture, void* pixels, int width, int height);
+extern void free_pixels(void* pixels);
+extern bakedfont_t* bake_font(const char* filename, int pixel_size, const fontoptions_t* options);
+extern font_t upload_font(bakedfont_t* baked);
+
+extern texture_t _create_texture(int width, int height, textureformat_t format);
+extern void _update_texture(texture_t texture, int x, int y, int width, int height, const void* pixels);
+extern void forget_dynamic_texture(texture_t texture);
+extern void free_texture_streams(void);
+
+extern texture_t _load_texture(const char* filename);
+extern font_t _load_font(const char* filename);
+extern font_t _load_font_ex(const char* filename, int pixel_size, const fontoptions_t* options);
+extern texture_t _load_texture_memory(const void* buffer, int size, bool adopt);
+extern font_t _load_font_memory(const void* buffer, int size, bool adopt);
+extern void _free_texture(texture_t texture);
+extern void _free_font(font_t font);
+extern void _set_blend(blend_t blend);
+extern void _set_texture(texture_t texture);
+extern void _set_color(color_t color);
+extern void set_font_texture(texture_t texture);
+
+extern rendertarget_t _create_render_target(int width, int height);
+extern void _free_render_target(rendertarget_t target);
+extern void _set_render_target(rendertarget_t target);
+extern texture_t _get_render_target_texture(rendertarget_t target);
+extern void _clear(color_t color);
+
+extern void flush_batch(flushreason_t reason);
+extern void bind_program(const float* model);
+extern void apply_texture(void);
+extern bool gfx_compat(void);
+
+extern mesh_t _create_mesh(const colorvertex_t* vertices, int num_vertices, const unsigned int* indices, int num_indices);
+extern void _free_mesh(mesh_t mesh);
+extern void _draw_mesh(mesh_t mesh, const transform_t* transform);
+
+extern void get_view_rect(float* x0, float* y0, float* x1, float* y1);
+extern void _set_camera(const camera_t* camera);
+extern void _push_transform(const transform_t* transform);
+extern void _pop_transform(void);
+
+//per particle instance data, matches the instanced vertex layout
+typedef struct
+{
+	float x, y, size;
+	color_t color;
+} particleinstance_t;
+
+extern void bind_particle_program(void);
+extern particles_t _create_particles(int max_particles, const particleparams_t* params);
+extern void _free_particles(particles_t particles);
+extern void _emit_particles(particles_t particles, int count, const particleemit_t* emit);
+extern void _update_particles(particles_t particles, float dt);
+extern void _draw_particles(particles_t particles);
+extern int _particle_count(particles_t particles);
+extern const particleinstance_t* stage_particles(particles_t particles, int slot, int* count);
+extern void draw_particle_instances(particles_t particles, const particleinstance_t* instances, int count);
+
+extern tilemap_t _create_tilemap(int width, int height, float tile_size, texture_t atlas, int atlas_columns, int atlas_rows);
+extern void _free_tilemap(tilemap_t tilemap);
+extern void _set_tile(tilemap_t tilemap, int x, int y, int tile);
+extern int _get_tile(tilemap_t tilemap, int x, int y);
+extern void _draw_tilemap(tilemap_t tilemap, float x, float y);
+
+extern shader_t _load_shader(const char* vertex_filename, const char* fragment_filename);
+extern shader_t _create_shader(const char* vertex_source, const char* fragment_source);
+extern void _free_shader(shader_t shader);
+extern void _set_shader(shader_t shader);
+extern void set_uniform(const char* name, const uniformvalue_t* value);
+extern void _set_uniform_int(const char* name, int value);
+extern void _set_uniform_float(const char* name, float value);
+extern void _set_uniform_vec2(const char* name, float x, float y);
+extern void _set_uniform_vec4(const char* name, float x, float y, float z, float w);
+
+extern void init_drawlist_lib(libgfx_t* gfx);
+extern drawlist_t _create_drawlist(void);
+extern void _free_drawlist(drawlist_t list);
+extern void _drawlist_reset(drawlist_t list);
+extern void _drawlist_append(drawlist_t dst, drawlist_t src);
+extern void _drawlist_set_blend(drawlist_t list, blend_t blend);
+extern void _drawlist_set_texture(drawlist_t list, texture_t texture);
+extern void _drawlist_set_color(drawlist_t list, color_t color);
+extern void _drawlist_rect(drawlist_t list, float x, float y, float width, float height);
+extern void _drawlist_sprite(drawlist_t list, float x, float y, float width, float height, float rotation);
+extern void _drawlist_quad(drawlist_t list, vertex_t vertices[4]);
+extern void _drawlist_polygon(drawlist_t list, vertex_t* vertices, int num_vertices);
+extern void _drawlist_text(drawlist_t list, font_t font, float x, float y, const char* text);
+extern void _drawlist_quad_colored(drawlist_t list, colorvertex_t vertices[4]);
+extern void _drawlist_polygon_colored(drawlist_t list, colorvertex_t* vertices, int num_vertices);
+extern void _drawlist_set_shader(drawlist_t list, shader_t shader);
+extern void _drawlist_set_render_target(drawlist_t list, rendertarget_t target);
+extern void _drawlist_clear(drawlist_t list, color_t color);
+extern void _drawlist_mesh(drawlist_t list, mesh_t mesh, const transform_t* transform);
+extern void _drawlist_tilemap(drawlist_t list, tilemap_t tilemap, float x, float y);
+extern void _drawlist_set_camera(drawlist_t list, const camera_t* camera);
+extern void _drawlist_push_transform(drawlist_t list, const transform_t* transform);
+extern void _drawlist_pop_transform(drawlist_t list);
+extern void _drawlist_update_texture(drawlist_t list, texture_t texture, int x, int y, int width, int height, const void* pixels);
+extern void _drawlist_particles(drawlist_t list, particles_t particles, const particleinstance_t* instances, int count);
+extern void _drawlist_set_uniform_int(drawlist_t list, const char* name, int value);
+extern void _drawlist_set_uniform_float(drawlist_t list, const char* name, float value);
+extern void _drawlist_set_uniform_vec2(drawlist_t list, const char* name, float x, float y);
+extern void _drawlist_set_uniform_vec4(drawlist_t list, const char* name, float x, float y, float z, float w);
+extern void _submit_drawlists(drawlist_t* lists, int num_lists);
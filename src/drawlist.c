@@ -0,0 +1,477 @@
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "memory.h"
+
+typedef enum
+{
+	DLCMD_BLEND,
+	DLCMD_TEXTURE,
+	DLCMD_COLOR,
+	DLCMD_PUSH_TEXTURE,
+	DLCMD_POP_TEXTURE,
+	DLCMD_QUADS, //colors come from the current set_color on submit
+	DLCMD_COLORED_QUADS,
+	DLCMD_SHADER,
+	DLCMD_UNIFORM,
+	DLCMD_TARGET,
+	DLCMD_CLEAR,
+	DLCMD_MESH,
+	DLCMD_TILEMAP,
+	DLCMD_CAMERA,
+	DLCMD_PUSH_TRANSFORM,
+	DLCMD_POP_TRANSFORM,
+	DLCMD_PARTICLES,
+	DLCMD_UPDATE_TEXTURE,
+} dlcmd_type_t;
+
+typedef struct
+{
+	dlcmd_type_t type;
+	union
+	{
+		blend_t blend;
+		texture_t texture;
+		color_t color;
+		shader_t shader;
+		rendertarget_t target;
+		struct { mesh_t mesh; bool transformed; transform_t transform; } mesh;
+		struct { tilemap_t tilemap; float x, y; } tilemap;
+		struct { bool set; camera_t camera; } camera;
+		transform_t transform;
+		struct { particles_t particles; const particleinstance_t* instances; int count; } particles;
+		struct { int first, count; } quads;
+		struct { int name; uniformvalue_t value; } uniform; //name is an offset into the list's strings
+		struct { texture_t texture; int x, y, width, height, pixels; } update; //pixels too
+	} data;
+} dlcmd_t;
+
+typedef struct
+{
+	dlcmd_t* cmds;
+	int num_cmds;
+	int max_cmds;
+	colorvertex_t* vertices;
+	int num_vertices;
+	int max_vertices;
+	char* strings;
+	int num_chars;
+	int max_chars;
+} drawlistdata_t;
+
+static dlcmd_t* push_cmd(drawlistdata_t* list, dlcmd_type_t type)
+{
+	dlcmd_t* cmd;
+	if ( list->num_cmds == list->max_cmds )
+	{
+		list->max_cmds = list->max_cmds ? list->max_cmds * 2 : 64;
+		list->cmds = (dlcmd_t*) mem_realloc(list->cmds, sizeof(dlcmd_t) * list->max_cmds, MEMORY_DRAWLIST);
+	}
+	cmd = &list->cmds[list->num_cmds++];
+	cmd->type = type;
+	return cmd;
+}
+
+//reserves room for vertices, extending the previous quad run when possible
+static colorvertex_t* push_quads(drawlistdata_t* list, int num_vertices, dlcmd_type_t type)
+{
+	dlcmd_t* last = list->num_cmds ? &list->cmds[list->num_cmds-1] : NULL;
+	colorvertex_t* out;
+
+	if ( list->num_vertices + num_vertices > list->max_vertices )
+	{
+		while ( list->num_vertices + num_vertices > list->max_vertices )
+		{
+			list->max_vertices = list->max_vertices ? list->max_vertices * 2 : 1024;
+		}
+		list->vertices = (colorvertex_t*) mem_realloc(list->vertices, sizeof(colorvertex_t) * list->max_vertices, MEMORY_DRAWLIST);
+	}
+
+	if ( last == NULL || last->type != type )
+	{
+		last = push_cmd(list, type);
+		last->data.quads.first = list->num_vertices;
+		last->data.quads.count = 0;
+	}
+
+	out = list->vertices + list->num_vertices;
+	last->data.quads.count += num_vertices;
+	list->num_vertices += num_vertices;
+	return out;
+}
+
+static int push_bytes(drawlistdata_t* list, const void* data, int length)
+{
+	int offset = list->num_chars;
+
+	if ( list->num_chars + length > list->max_chars )
+	{
+		while ( list->num_chars + length > list->max_chars )
+		{
+			list->max_chars = list->max_chars ? list->max_chars * 2 : 256;
+		}
+		list->strings = (char*) mem_realloc(list->strings, list->max_chars, MEMORY_DRAWLIST);
+	}
+
+	memcpy(list->strings + offset, data, length);
+	list->num_chars += length;
+	return offset;
+}
+
+static int push_string(drawlistdata_t* list, const char* str)
+{
+	return push_bytes(list, str, (int) strlen(str) + 1);
+}
+
+drawlist_t _create_drawlist(void)
+{
+	drawlistdata_t* list = (drawlistdata_t*) mem_alloc(sizeof(drawlistdata_t), MEMORY_DRAWLIST);
+	memset(list, 0, sizeof(drawlistdata_t));
+	return list;
+}
+
+void _free_drawlist(drawlist_t list)
+{
+	drawlistdata_t* data = (drawlistdata_t*) list;
+	if ( data == NULL ) return;
+
+	mem_free(data->cmds);
+	mem_free(data->vertices);
+	mem_free(data->strings);
+	mem_free(data);
+}
+
+void _drawlist_reset(drawlist_t list)
+{
+	drawlistdata_t* data = (drawlistdata_t*) list;
+	data->num_cmds = 0;
+	data->num_vertices = 0;
+	data->num_chars = 0;
+}
+
+//copies src onto the end of dst so dst can outlive changes to src
+void _drawlist_append(drawlist_t dst, drawlist_t src)
+{
+	drawlistdata_t* to = (drawlistdata_t*) dst;
+	drawlistdata_t* from = (drawlistdata_t*) src;
+	int i;
+
+	for (i=0; i<from->num_cmds; ++i)
+	{
+		dlcmd_t* cmd = &from->cmds[i];
+		if ( cmd->type == DLCMD_QUADS || cmd->type == DLCMD_COLORED_QUADS )
+		{
+			colorvertex_t* out = push_quads(to, cmd->data.quads.count, cmd->type);
+			memcpy(out, from->vertices + cmd->data.quads.first, sizeof(colorvertex_t) * cmd->data.quads.count);
+		}
+		else if ( cmd->type == DLCMD_UNIFORM )
+		{
+			dlcmd_t* copy = push_cmd(to, cmd->type);
+			copy->data.uniform.value = cmd->data.uniform.value;
+			copy->data.uniform.name = push_string(to, from->strings + cmd->data.uniform.name);
+		}
+		else if ( cmd->type == DLCMD_UPDATE_TEXTURE )
+		{
+			dlcmd_t* copy = push_cmd(to, DLCMD_UPDATE_TEXTURE);
+			*copy = *cmd;
+			copy->data.update.pixels = push_bytes(to, from->strings + cmd->data.update.pixels, cmd->data.update.width * cmd->data.update.height * 4);
+		}
+		else
+		{
+			*push_cmd(to, cmd->type) = *cmd;
+		}
+	}
+}
+
+void _drawlist_set_blend(drawlist_t list, blend_t blend)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_BLEND)->data.blend = blend;
+}
+
+void _drawlist_set_texture(drawlist_t list, texture_t texture)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_TEXTURE)->data.texture = texture;
+}
+
+void _drawlist_set_color(drawlist_t list, color_t color)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_COLOR)->data.color = color;
+}
+
+void _drawlist_set_shader(drawlist_t list, shader_t shader)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_SHADER)->data.shader = shader;
+}
+
+void _drawlist_set_render_target(drawlist_t list, rendertarget_t target)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_TARGET)->data.target = target;
+}
+
+void _drawlist_clear(drawlist_t list, color_t color)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_CLEAR)->data.color = color;
+}
+
+void _drawlist_mesh(drawlist_t list, mesh_t mesh, const transform_t* transform)
+{
+	dlcmd_t* cmd = push_cmd((drawlistdata_t*) list, DLCMD_MESH);
+	cmd->data.mesh.mesh = mesh;
+	cmd->data.mesh.transformed = transform != NULL;
+	if ( transform ) cmd->data.mesh.transform = *transform;
+}
+
+void _drawlist_tilemap(drawlist_t list, tilemap_t tilemap, float x, float y)
+{
+	dlcmd_t* cmd = push_cmd((drawlistdata_t*) list, DLCMD_TILEMAP);
+	cmd->data.tilemap.tilemap = tilemap;
+	cmd->data.tilemap.x = x;
+	cmd->data.tilemap.y = y;
+}
+
+void _drawlist_set_camera(drawlist_t list, const camera_t* camera)
+{
+	dlcmd_t* cmd = push_cmd((drawlistdata_t*) list, DLCMD_CAMERA);
+	cmd->data.camera.set = camera != NULL;
+	if ( camera ) cmd->data.camera.camera = *camera;
+}
+
+void _drawlist_push_transform(drawlist_t list, const transform_t* transform)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_PUSH_TRANSFORM)->data.transform = *transform;
+}
+
+void _drawlist_pop_transform(drawlist_t list)
+{
+	push_cmd((drawlistdata_t*) list, DLCMD_POP_TRANSFORM);
+}
+
+//instances are referenced, not copied, they have to outlive the list's submission
+void _drawlist_particles(drawlist_t list, particles_t particles, const particleinstance_t* instances, int count)
+{
+	dlcmd_t* cmd = push_cmd((drawlistdata_t*) list, DLCMD_PARTICLES);
+	cmd->data.particles.particles = particles;
+	cmd->data.particles.instances = instances;
+	cmd->data.particles.count = count;
+}
+
+void _drawlist_update_texture(drawlist_t list, texture_t texture, int x, int y, int width, int height, const void* pixels)
+{
+	drawlistdata_t* data = (drawlistdata_t*) list;
+	int offset;
+	dlcmd_t* cmd;
+
+	if ( pixels == NULL || width <= 0 || height <= 0 ) return;
+
+	offset = push_bytes(data, pixels, width * height * 4);
+	cmd = push_cmd(data, DLCMD_UPDATE_TEXTURE);
+	cmd->data.update.texture = texture;
+	cmd->data.update.x = x;
+	cmd->data.update.y = y;
+	cmd->data.update.width = width;
+	cmd->data.update.height = height;
+	cmd->data.update.pixels = offset;
+}
+
+static void push_uniform(drawlistdata_t* list, const char* name, const uniformvalue_t* value)
+{
+	int offset = push_string(list, name);
+	dlcmd_t* cmd = push_cmd(list, DLCMD_UNIFORM);
+	cmd->data.uniform.name = offset;
+	cmd->data.uniform.value = *value;
+}
+
+void _drawlist_set_uniform_int(drawlist_t list, const char* name, int x)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_INT;
+	value.data.i = x;
+	push_uniform((drawlistdata_t*) list, name, &value);
+}
+
+void _drawlist_set_uniform_float(drawlist_t list, const char* name, float x)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_FLOAT;
+	value.data.f[0] = x;
+	push_uniform((drawlistdata_t*) list, name, &value);
+}
+
+void _drawlist_set_uniform_vec2(drawlist_t list, const char* name, float x, float y)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_VEC2;
+	value.data.f[0] = x;
+	value.data.f[1] = y;
+	push_uniform((drawlistdata_t*) list, name, &value);
+}
+
+void _drawlist_set_uniform_vec4(drawlist_t list, const char* name, float x, float y, float z, float w)
+{
+	uniformvalue_t value;
+	value.type = UNIFORM_VEC4;
+	value.data.f[0] = x;
+	value.data.f[1] = y;
+	value.data.f[2] = z;
+	value.data.f[3] = w;
+	push_uniform((drawlistdata_t*) list, name, &value);
+}
+
+void _drawlist_rect(drawlist_t list, float x, float y, float width, float height)
+{
+	build_rect(push_quads((drawlistdata_t*) list, 4, DLCMD_QUADS), x, y, width, height, 0);
+}
+
+void _drawlist_sprite(drawlist_t list, float x, float y, float width, float height, float rotation)
+{
+	build_sprite(push_quads((drawlistdata_t*) list, 4, DLCMD_QUADS), x, y, width, height, rotation, 0);
+}
+
+void _drawlist_polygon(drawlist_t list, vertex_t* vertices, int num_vertices)
+{
+	colorvertex_t* out = push_quads((drawlistdata_t*) list, num_vertices, DLCMD_QUADS);
+	int i;
+
+	for (i=0; i<num_vertices; ++i)
+	{
+		out[i].x = vertices[i].x;
+		out[i].y = vertices[i].y;
+		out[i].u = vertices[i].u;
+		out[i].v = vertices[i].v;
+		out[i].color = 0;
+	}
+}
+
+void _drawlist_quad(drawlist_t list, vertex_t vertices[4])
+{
+	_drawlist_polygon(list, vertices, 4);
+}
+
+void _drawlist_polygon_colored(drawlist_t list, colorvertex_t* vertices, int num_vertices)
+{
+	memcpy(push_quads((drawlistdata_t*) list, num_vertices, DLCMD_COLORED_QUADS), vertices, sizeof(colorvertex_t) * num_vertices);
+}
+
+void _drawlist_quad_colored(drawlist_t list, colorvertex_t vertices[4])
+{
+	_drawlist_polygon_colored(list, vertices, 4);
+}
+
+void _drawlist_text(drawlist_t list, font_t font, float x, float y, const char* text)
+{
+	drawlistdata_t* data = (drawlistdata_t*) list;
+	int count;
+	if ( font == NULL ) return;
+
+	count = text_quad_count(font, text);
+	if ( count == 0 ) return;
+
+	push_cmd(data, DLCMD_PUSH_TEXTURE)->data.texture = font_texture(font);
+	build_text(push_quads(data, count * 4, DLCMD_QUADS), font, x, y, text, 0);
+	push_cmd(data, DLCMD_POP_TEXTURE);
+}
+
+void _submit_drawlists(drawlist_t* lists, int num_lists)
+{
+	int i, j;
+	texture_t saved = 0;
+
+	for (i=0; i<num_lists; ++i)
+	{
+		drawlistdata_t* list = (drawlistdata_t*) lists[i];
+		if ( list == NULL ) continue;
+
+		for (j=0; j<list->num_cmds; ++j)
+		{
+			dlcmd_t* cmd = &list->cmds[j];
+			switch( cmd->type )
+			{
+				case DLCMD_BLEND:
+				_set_blend(cmd->data.blend);
+				break;
+				case DLCMD_TEXTURE:
+				_set_texture(cmd->data.texture);
+				break;
+				case DLCMD_COLOR:
+				_set_color(cmd->data.color);
+				break;
+				case DLCMD_PUSH_TEXTURE:
+				saved = current_texture();
+				set_font_texture(cmd->data.texture);
+				break;
+				case DLCMD_POP_TEXTURE:
+				_set_texture(saved);
+				break;
+				case DLCMD_QUADS:
+				emit_vertices(list->vertices + cmd->data.quads.first, cmd->data.quads.count, true);
+				break;
+				case DLCMD_COLORED_QUADS:
+				emit_vertices(list->vertices + cmd->data.quads.first, cmd->data.quads.count, false);
+				break;
+				case DLCMD_SHADER:
+				_set_shader(cmd->data.shader);
+				break;
+				case DLCMD_TARGET:
+				_set_render_target(cmd->data.target);
+				break;
+				case DLCMD_CLEAR:
+				_clear(cmd->data.color);
+				break;
+				case DLCMD_MESH:
+				_draw_mesh(cmd->data.mesh.mesh, cmd->data.mesh.transformed ? &cmd->data.mesh.transform : NULL);
+				break;
+				case DLCMD_TILEMAP:
+				_draw_tilemap(cmd->data.tilemap.tilemap, cmd->data.tilemap.x, cmd->data.tilemap.y);
+				break;
+				case DLCMD_CAMERA:
+				_set_camera(cmd->data.camera.set ? &cmd->data.camera.camera : NULL);
+				break;
+				case DLCMD_PUSH_TRANSFORM:
+				_push_transform(&cmd->data.transform);
+				break;
+				case DLCMD_POP_TRANSFORM:
+				_pop_transform();
+				break;
+				case DLCMD_PARTICLES:
+				draw_particle_instances(cmd->data.particles.particles, cmd->data.particles.instances, cmd->data.particles.count);
+				break;
+				case DLCMD_UPDATE_TEXTURE:
+				_update_texture(cmd->data.update.texture, cmd->data.update.x, cmd->data.update.y,
+					cmd->data.update.width, cmd->data.update.height, list->strings + cmd->data.update.pixels);
+				break;
+				case DLCMD_UNIFORM:
+				set_uniform(list->strings + cmd->data.uniform.name, &cmd->data.uniform.value);
+				break;
+			}
+		}
+	}
+}
+
+void init_drawlist_lib(libgfx_t* gfx)
+{
+	gfx->create_drawlist = _create_drawlist;
+	gfx->free_drawlist = _free_drawlist;
+	gfx->drawlist_reset = _drawlist_reset;
+	gfx->drawlist_set_blend = _drawlist_set_blend;
+	gfx->drawlist_set_texture = _drawlist_set_texture;
+	gfx->drawlist_set_color = _drawlist_set_color;
+	gfx->drawlist_rect = _drawlist_rect;
+	gfx->drawlist_sprite = _drawlist_sprite;
+	gfx->drawlist_quad = _drawlist_quad;
+	gfx->drawlist_polygon = _drawlist_polygon;
+	gfx->drawlist_text = _drawlist_text;
+	gfx->drawlist_quad_colored = _drawlist_quad_colored;
+	gfx->drawlist_polygon_colored = _drawlist_polygon_colored;
+	gfx->drawlist_set_shader = _drawlist_set_shader;
+	gfx->drawlist_set_uniform_int = _drawlist_set_uniform_int;
+	gfx->drawlist_set_uniform_float = _drawlist_set_uniform_float;
+	gfx->drawlist_set_uniform_vec2 = _drawlist_set_uniform_vec2;
+	gfx->drawlist_set_uniform_vec4 = _drawlist_set_uniform_vec4;
+	gfx->drawlist_mesh = _drawlist_mesh;
+	gfx->drawlist_tilemap = _drawlist_tilemap;
+	gfx->drawlist_set_camera = _drawlist_set_camera;
+	gfx->drawlist_push_transform = _drawlist_push_transform;
+	gfx->drawlist_pop_transform = _drawlist_pop_transform;
+	gfx->drawlist_update_texture = _drawlist_update_texture;
+	gfx->submit_drawlists = _submit_drawlists;
+}
@@ -0,0 +1,127 @@
+#include <stdio.h>
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "glload.h"
+
+//glad declares every GL 4.0 function and extension, loading them all costs thousands of
+//lookups at startup. this table holds the ones the library actually uses, new GL calls
+//have to be added here. GL_CORE and GL_COMPAT are only required by that renderer, optional
+//ones belong to extensions checked before use
+#define PROFILE_CORE 1
+#define PROFILE_COMPAT 2
+#define GL_FUNC(name) { #name, (void**) &glad_##name, PROFILE_CORE | PROFILE_COMPAT }
+#define GL_CORE(name) { #name, (void**) &glad_##name, PROFILE_CORE }
+#define GL_COMPAT(name) { #name, (void**) &glad_##name, PROFILE_COMPAT }
+#define GL_OPTIONAL(name) { #name, (void**) &glad_##name, 0 }
+
+typedef struct
+{
+	const char* name;
+	void** func;
+	int required; //profiles that can't run without it
+} glfunc_t;
+
+static const glfunc_t g_functions[] =
+{
+	GL_FUNC(glActiveTexture),
+	GL_CORE(glAttachShader),
+	GL_COMPAT(glBegin),
+	GL_FUNC(glBindBuffer),
+	GL_FUNC(glBindFramebuffer),
+	GL_FUNC(glBindTexture),
+	GL_CORE(glBindVertexArray),
+	GL_FUNC(glBlendEquation),
+	GL_FUNC(glBlendFunc),
+	GL_FUNC(glBufferData),
+	GL_OPTIONAL(glBufferStorage),
+	GL_CORE(glBufferSubData),
+	GL_FUNC(glCheckFramebufferStatus),
+	GL_FUNC(glClear),
+	GL_CORE(glClientWaitSync),
+	GL_FUNC(glClearColor),
+	GL_COMPAT(glColor4ubv),
+	GL_COMPAT(glColorPointer),
+	GL_CORE(glCompileShader),
+	GL_CORE(glCreateProgram),
+	GL_CORE(glCreateShader),
+	GL_FUNC(glDeleteBuffers),
+	GL_FUNC(glDeleteFramebuffers),
+	GL_CORE(glDeleteProgram),
+	GL_CORE(glDeleteShader),
+	GL_CORE(glDeleteSync),
+	GL_FUNC(glDeleteTextures),
+	GL_CORE(glDeleteVertexArrays),
+	GL_FUNC(glDisable),
+	GL_COMPAT(glDisableClientState),
+	GL_CORE(glDrawArraysInstanced),
+	GL_FUNC(glDrawElements),
+	GL_FUNC(glEnable),
+	GL_COMPAT(glEnableClientState),
+	GL_CORE(glEnableVertexAttribArray),
+	GL_COMPAT(glEnd),
+	GL_CORE(glFenceSync),
+	GL_FUNC(glFramebufferTexture2D),
+	GL_FUNC(glGenBuffers),
+	GL_FUNC(glGenFramebuffers),
+	GL_FUNC(glGenTextures),
+	GL_CORE(glGenVertexArrays),
+	GL_FUNC(glGetIntegerv),
+	GL_CORE(glGetProgramInfoLog),
+	GL_CORE(glGetProgramiv),
+	GL_CORE(glGetShaderInfoLog),
+	GL_CORE(glGetShaderiv),
+	GL_FUNC(glGetString),
+	GL_CORE(glGetUniformLocation),
+	GL_CORE(glLinkProgram),
+	GL_COMPAT(glLoadIdentity),
+	GL_CORE(glMapBufferRange),
+	GL_COMPAT(glMultMatrixf),
+	GL_COMPAT(glOrtho),
+	GL_FUNC(glPixelStorei),
+	GL_COMPAT(glPopMatrix),
+	GL_COMPAT(glPushMatrix),
+	GL_FUNC(glScissor),
+	GL_CORE(glShaderSource),
+	GL_COMPAT(glTexCoord2f),
+	GL_COMPAT(glTexCoordPointer),
+	GL_FUNC(glTexImage2D),
+	GL_FUNC(glTexParameteri),
+	GL_FUNC(glTexSubImage2D),
+	GL_CORE(glUniform1fv),
+	GL_CORE(glUniform1i),
+	GL_CORE(glUniform2fv),
+	GL_CORE(glUniform4fv),
+	GL_CORE(glUniformMatrix4fv),
+	GL_CORE(glUnmapBuffer),
+	GL_CORE(glUseProgram),
+	GL_COMPAT(glVertex2f),
+	GL_CORE(glVertexAttribDivisor),
+	GL_CORE(glVertexAttribPointer),
+	GL_COMPAT(glVertexPointer),
+	GL_FUNC(glViewport),
+};
+
+bool load_gl(struct GLFWwindow* window, bool compat)
+{
+	int count = sizeof(g_functions) / sizeof(g_functions[0]);
+	int profile = compat ? PROFILE_COMPAT : PROFILE_CORE;
+	bool complete = true;
+	int i;
+
+	for (i=0; i<count; ++i)
+	{
+		*g_functions[i].func = (void*) glfwGetProcAddress(g_functions[i].name);
+
+		if ( *g_functions[i].func == NULL && (g_functions[i].required & profile) )
+		{
+			printf("CAN'T FIND GL FUNCTION %s\n", g_functions[i].name);
+			complete = false;
+		}
+	}
+
+	GLVersion.major = glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MAJOR);
+	GLVersion.minor = glfwGetWindowAttrib(window, GLFW_CONTEXT_VERSION_MINOR);
+	GLAD_GL_ARB_buffer_storage = glfwExtensionSupported("GL_ARB_buffer_storage") && glad_glBufferStorage != NULL;
+
+	return complete;
+}
@@ -0,0 +1,6 @@
+#include "lib.h"
+
+struct GLFWwindow;
+
+//resolves only the GL entry points the library calls, in place of gladLoadGLLoader
+extern bool load_gl(struct GLFWwindow* window, bool compat);
@@ -0,0 +1,254 @@
+#include <glad/glad.h>
+#include "glstate.h"
+#include "stats.h"
+
+#define GL_UNKNOWN 0xFFFFFFFFu
+
+typedef struct
+{
+	GLuint program;
+	GLuint active_unit;
+	GLuint textures[MAX_TEXTURE_UNITS];
+	GLenum blend_src;
+	GLenum blend_dst;
+	GLenum blend_equation;
+	int scissor_enabled; //-1 unknown
+	int scissor[4];
+	int viewport[4];
+	GLuint array_buffer;
+	GLuint element_buffer; //part of the vao, unknown after every vao change
+	GLuint unpack_buffer;
+	GLuint vao;
+	GLuint framebuffer;
+} glstate_t;
+
+static glstate_t g_gl;
+static int g_issued = 0;
+static int g_filtered = 0;
+static int g_last_issued = 0;
+static int g_last_filtered = 0;
+
+//true when the call has to reach GL
+static bool changed(GLuint* shadow, GLuint value)
+{
+	if ( *shadow == value )
+	{
+		g_filtered++;
+		return false;
+	}
+
+	*shadow = value;
+	g_issued++;
+	return true;
+}
+
+void reset_gl_state(void)
+{
+	int i;
+
+	g_gl.program = GL_UNKNOWN;
+	g_gl.active_unit = GL_UNKNOWN;
+	for (i=0; i<MAX_TEXTURE_UNITS; ++i) g_gl.textures[i] = GL_UNKNOWN;
+	g_gl.blend_src = GL_UNKNOWN;
+	g_gl.blend_dst = GL_UNKNOWN;
+	g_gl.blend_equation = GL_UNKNOWN;
+	g_gl.scissor_enabled = -1;
+	for (i=0; i<4; ++i) g_gl.scissor[i] = g_gl.viewport[i] = -1;
+	g_gl.array_buffer = GL_UNKNOWN;
+	g_gl.element_buffer = GL_UNKNOWN;
+	g_gl.unpack_buffer = GL_UNKNOWN;
+	g_gl.vao = GL_UNKNOWN;
+	g_gl.framebuffer = GL_UNKNOWN;
+
+	g_issued = g_filtered = 0;
+	g_last_issued = g_last_filtered = 0;
+}
+
+void gl_use_program(unsigned int program)
+{
+	if ( changed(&g_gl.program, program) ) glUseProgram(program);
+}
+
+void gl_bind_texture(int unit, unsigned int texture)
+{
+	if ( g_gl.textures[unit] == texture )
+	{
+		g_filtered++;
+		return;
+	}
+
+	if ( g_gl.active_unit != (GLuint) unit )
+	{
+		g_gl.active_unit = unit;
+		g_issued++;
+		glActiveTexture(GL_TEXTURE0 + unit);
+	}
+
+	g_gl.textures[unit] = texture;
+	g_issued++;
+	g_frame_stats.texture_binds++;
+	glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void gl_blend_func(unsigned int src, unsigned int dst)
+{
+	if ( g_gl.blend_src == src && g_gl.blend_dst == dst )
+	{
+		g_filtered++;
+		return;
+	}
+
+	g_gl.blend_src = src;
+	g_gl.blend_dst = dst;
+	g_issued++;
+	g_frame_stats.blend_changes++;
+	glBlendFunc(src, dst);
+}
+
+void gl_blend_equation(unsigned int mode)
+{
+	if ( !changed(&g_gl.blend_equation, mode) ) return;
+
+	g_frame_stats.blend_changes++;
+	glBlendEquation(mode);
+}
+
+void gl_scissor(bool enabled, int x, int y, int width, int height)
+{
+	if ( g_gl.scissor_enabled != (enabled ? 1 : 0) )
+	{
+		g_gl.scissor_enabled = enabled ? 1 : 0;
+		g_issued++;
+		if ( enabled ) glEnable(GL_SCISSOR_TEST);
+		else glDisable(GL_SCISSOR_TEST);
+	}
+	else
+	{
+		g_filtered++;
+	}
+
+	//the rectangle is kept while disabled
+	if ( !enabled ) return;
+
+	if ( g_gl.scissor[0] == x && g_gl.scissor[1] == y && g_gl.scissor[2] == width && g_gl.scissor[3] == height )
+	{
+		g_filtered++;
+		return;
+	}
+
+	g_gl.scissor[0] = x;
+	g_gl.scissor[1] = y;
+	g_gl.scissor[2] = width;
+	g_gl.scissor[3] = height;
+	g_issued++;
+	glScissor(x, y, width, height);
+}
+
+void gl_viewport(int x, int y, int width, int height)
+{
+	if ( g_gl.viewport[0] == x && g_gl.viewport[1] == y && g_gl.viewport[2] == width && g_gl.viewport[3] == height )
+	{
+		g_filtered++;
+		return;
+	}
+
+	g_gl.viewport[0] = x;
+	g_gl.viewport[1] = y;
+	g_gl.viewport[2] = width;
+	g_gl.viewport[3] = height;
+	g_issued++;
+	glViewport(x, y, width, height);
+}
+
+static GLuint* buffer_shadow(GLenum target)
+{
+	switch( target )
+	{
+		case GL_ARRAY_BUFFER: return &g_gl.array_buffer;
+		case GL_ELEMENT_ARRAY_BUFFER: return &g_gl.element_buffer;
+		case GL_PIXEL_UNPACK_BUFFER: return &g_gl.unpack_buffer;
+	}
+	return NULL;
+}
+
+void gl_bind_buffer(unsigned int target, unsigned int buffer)
+{
+	GLuint* shadow = buffer_shadow(target);
+
+	if ( shadow == NULL )
+	{
+		g_issued++;
+		glBindBuffer(target, buffer);
+		return;
+	}
+
+	if ( changed(shadow, buffer) ) glBindBuffer(target, buffer);
+}
+
+void gl_bind_vertex_array(unsigned int vao)
+{
+	if ( !changed(&g_gl.vao, vao) ) return;
+
+	glBindVertexArray(vao);
+	g_gl.element_buffer = GL_UNKNOWN;
+}
+
+void gl_bind_framebuffer(unsigned int framebuffer)
+{
+	if ( changed(&g_gl.framebuffer, framebuffer) ) glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+//GL drops deleted objects from the current bindings, the shadow has to follow
+void gl_delete_texture(unsigned int texture)
+{
+	int i;
+	for (i=0; i<MAX_TEXTURE_UNITS; ++i)
+	{
+		if ( g_gl.textures[i] == texture ) g_gl.textures[i] = 0;
+	}
+	glDeleteTextures(1, &texture);
+}
+
+void gl_delete_buffer(unsigned int buffer)
+{
+	if ( g_gl.array_buffer == buffer ) g_gl.array_buffer = 0;
+	if ( g_gl.element_buffer == buffer ) g_gl.element_buffer = 0;
+	if ( g_gl.unpack_buffer == buffer ) g_gl.unpack_buffer = 0;
+	glDeleteBuffers(1, &buffer);
+}
+
+void gl_delete_vertex_array(unsigned int vao)
+{
+	if ( g_gl.vao == vao )
+	{
+		g_gl.vao = 0;
+		g_gl.element_buffer = GL_UNKNOWN;
+	}
+	glDeleteVertexArrays(1, &vao);
+}
+
+//a current program outlives glDeleteProgram, so it's unbound first
+void gl_delete_program(unsigned int program)
+{
+	if ( g_gl.program == program ) gl_use_program(0);
+	glDeleteProgram(program);
+}
+
+void gl_delete_framebuffer(unsigned int framebuffer)
+{
+	if ( g_gl.framebuffer == framebuffer ) g_gl.framebuffer = 0;
+	glDeleteFramebuffers(1, &framebuffer);
+}
+
+void end_gl_state_frame(void)
+{
+	g_last_issued = g_issued;
+	g_last_filtered = g_filtered;
+	g_issued = g_filtered = 0;
+}
+
+void _get_state_calls(int* issued, int* filtered)
+{
+	if ( issued ) *issued = g_last_issued;
+	if ( filtered ) *filtered = g_last_filtered;
+}
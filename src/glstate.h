@@ -0,0 +1,35 @@
+#ifndef GAMELIB_GLSTATE_H
+#define GAMELIB_GLSTATE_H
+
+#include "lib.h"
+
+//shadow of the GL state the library touches. every bind goes through here so redundant
+//changes never reach the driver, only the thread owning the context may call these
+
+#define MAX_TEXTURE_UNITS 8
+
+//forgets everything, the next call of each kind is always issued
+extern void reset_gl_state(void);
+
+extern void gl_use_program(unsigned int program);
+extern void gl_bind_texture(int unit, unsigned int texture);
+extern void gl_blend_func(unsigned int src, unsigned int dst);
+extern void gl_blend_equation(unsigned int mode);
+extern void gl_scissor(bool enabled, int x, int y, int width, int height);
+extern void gl_viewport(int x, int y, int width, int height);
+extern void gl_bind_buffer(unsigned int target, unsigned int buffer);
+extern void gl_bind_vertex_array(unsigned int vao);
+extern void gl_bind_framebuffer(unsigned int framebuffer);
+
+//deleting through these keeps a recycled name from matching a stale binding
+extern void gl_delete_texture(unsigned int texture);
+extern void gl_delete_buffer(unsigned int buffer);
+extern void gl_delete_vertex_array(unsigned int vao);
+extern void gl_delete_program(unsigned int program);
+extern void gl_delete_framebuffer(unsigned int framebuffer);
+
+//closes the frame's counters, _get_state_calls reports the last closed frame
+extern void end_gl_state_frame(void);
+extern void _get_state_calls(int* issued, int* filtered);
+
+#endif //GAMELIB_GLSTATE_H
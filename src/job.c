@@ -0,0 +1,440 @@
+#include <stdlib.h>
+#include <string.h>
+#include "job.h"
+#include "memory.h"
+#include "thread.h"
+
+//work stealing scheduler, each thread owns a Chase-Lev deque it pushes and pops at the bottom
+//while idle threads steal from the top. slot 0 belongs to the main thread. threads outside
+//the pool hand jobs over through a locked queue the workers drain.
+
+#define MAX_JOB_THREADS 64
+#define MAX_JOBS 4096 //per thread, must be a power of two
+#define JOB_MASK (MAX_JOBS-1)
+
+typedef struct job_s
+{
+	job_func func;
+	job_range_func range;
+	void* data;
+	int first;
+	int last;
+	jobcounter_t* counter;
+	jobcounter_t* dependency;
+	struct job_s* next;
+	volatile long long live; //pool slot is queued or running
+	bool heap;
+} job_t;
+
+typedef struct
+{
+	volatile long long top;
+	volatile long long bottom;
+	job_t* jobs[MAX_JOBS];
+} deque_t;
+
+typedef struct
+{
+	deque_t deque;
+	job_t pool[MAX_JOBS];
+	unsigned int pool_index;
+	unsigned int seed;
+	thread_t thread;
+} worker_t;
+
+static worker_t* g_workers = NULL;
+static int g_num_workers = 0;
+static volatile long long g_running = 0;
+static volatile long long g_sleeping = 0;
+static volatile long long g_num_deferred = 0;
+static semaphore_t g_wake = NULL;
+static mutex_t g_deferred_lock = NULL;
+static job_t* g_deferred = NULL;
+static mutex_t g_inject_lock = NULL;
+static job_t* g_injected = NULL; //oldest first
+static job_t* g_injected_tail = NULL;
+static volatile long long g_num_injected = 0;
+static THREAD_LOCAL int g_thread_index = -1;
+
+static bool deque_push(deque_t* deque, job_t* job)
+{
+	long long b = atomic_get(&deque->bottom);
+	long long t = atomic_get(&deque->top);
+	if ( b - t >= MAX_JOBS ) return false;
+
+	deque->jobs[b & JOB_MASK] = job;
+	atomic_set(&deque->bottom, b + 1);
+	return true;
+}
+
+static job_t* deque_pop(deque_t* deque)
+{
+	long long b = atomic_get(&deque->bottom) - 1;
+	long long t;
+	job_t* job;
+
+	atomic_set(&deque->bottom, b);
+	t = atomic_get(&deque->top);
+
+	if ( t > b )
+	{
+		atomic_set(&deque->bottom, t);
+		return NULL;
+	}
+
+	job = deque->jobs[b & JOB_MASK];
+	if ( t != b ) return job;
+
+	//last job, race any thieves for it
+	if ( !atomic_cas(&deque->top, t, t + 1) ) job = NULL;
+	atomic_set(&deque->bottom, t + 1);
+	return job;
+}
+
+static job_t* deque_steal(deque_t* deque)
+{
+	long long t = atomic_get(&deque->top);
+	long long b = atomic_get(&deque->bottom);
+	job_t* job;
+
+	if ( t >= b ) return NULL;
+
+	job = deque->jobs[t & JOB_MASK];
+	if ( !atomic_cas(&deque->top, t, t + 1) ) return NULL;
+	return job;
+}
+
+static job_t* alloc_job(job_func func, void* data, jobcounter_t* counter)
+{
+	worker_t* worker = &g_workers[g_thread_index];
+	job_t* job = &worker->pool[worker->pool_index++ & JOB_MASK];
+
+	//the ring wrapped onto a job that hasn't finished, more than MAX_JOBS are outstanding
+	if ( atomic_get(&job->live) )
+	{
+		job = (job_t*) mem_calloc(1, sizeof(job_t), MEMORY_GENERAL);
+		job->heap = true;
+	}
+	else
+	{
+		memset(job, 0, sizeof(job_t));
+		atomic_set(&job->live, 1);
+	}
+
+	job->func = func;
+	job->data = data;
+	job->counter = counter;
+	if ( counter ) atomic_add(&counter->pending, 1);
+	return job;
+}
+
+static void release_deferred(void);
+
+static void execute_job(job_t* job)
+{
+	jobcounter_t* counter = job->counter;
+
+	if ( job->range ) job->range(job->data, job->first, job->last);
+	else job->func(job->data);
+
+	if ( job->heap ) mem_free(job);
+	else atomic_set(&job->live, 0);
+
+	if ( counter && atomic_add(&counter->pending, -1) == 0 && atomic_get(&g_num_deferred) > 0 )
+	{
+		release_deferred();
+	}
+}
+
+static void push_job(job_t* job)
+{
+	//deque is full, run it here rather than drop it
+	if ( !deque_push(&g_workers[g_thread_index].deque, job) )
+	{
+		execute_job(job);
+		return;
+	}
+
+	if ( atomic_get(&g_sleeping) > 0 ) semaphore_post(g_wake, 1);
+}
+
+static void release_deferred(void)
+{
+	job_t** link;
+	job_t* ready = NULL;
+
+	mutex_lock(g_deferred_lock);
+	link = &g_deferred;
+	while ( *link )
+	{
+		job_t* job = *link;
+		if ( atomic_get(&job->dependency->pending) == 0 )
+		{
+			*link = job->next;
+			atomic_add(&g_num_deferred, -1);
+			job->next = ready;
+			ready = job;
+		}
+		else
+		{
+			link = &job->next;
+		}
+	}
+	mutex_unlock(g_deferred_lock);
+
+	//pushed unlocked, a full deque runs the job inline and that can release more
+	while ( ready )
+	{
+		job_t* job = ready;
+		ready = job->next;
+		push_job(job);
+	}
+}
+
+static void inject_job(job_func func, void* data, jobcounter_t* counter)
+{
+	job_t* job = (job_t*) mem_calloc(1, sizeof(job_t), MEMORY_GENERAL);
+	job->func = func;
+	job->data = data;
+	job->counter = counter;
+	job->heap = true;
+	if ( counter ) atomic_add(&counter->pending, 1);
+
+	mutex_lock(g_inject_lock);
+	if ( g_injected_tail ) g_injected_tail->next = job;
+	else g_injected = job;
+	g_injected_tail = job;
+	mutex_unlock(g_inject_lock);
+
+	atomic_add(&g_num_injected, 1);
+	if ( atomic_get(&g_sleeping) > 0 ) semaphore_post(g_wake, 1);
+}
+
+static job_t* take_injected(void)
+{
+	job_t* job;
+
+	mutex_lock(g_inject_lock);
+	job = g_injected;
+	if ( job )
+	{
+		g_injected = job->next;
+		if ( g_injected == NULL ) g_injected_tail = NULL;
+		atomic_add(&g_num_injected, -1);
+	}
+	mutex_unlock(g_inject_lock);
+
+	return job;
+}
+
+static bool run_one(void)
+{
+	worker_t* self = &g_workers[g_thread_index];
+	job_t* job = deque_pop(&self->deque);
+	int i;
+
+	if ( job == NULL && atomic_get(&g_num_injected) > 0 ) job = take_injected();
+
+	if ( job == NULL && g_num_workers > 1 )
+	{
+		int start;
+		self->seed ^= self->seed << 13;
+		self->seed ^= self->seed >> 17;
+		self->seed ^= self->seed << 5;
+		start = (int) (self->seed % (unsigned int) g_num_workers);
+
+		for (i=0; i<g_num_workers && job == NULL; ++i)
+		{
+			int victim = (start + i) % g_num_workers;
+			if ( victim == g_thread_index ) continue;
+			job = deque_steal(&g_workers[victim].deque);
+		}
+	}
+
+	if ( job == NULL ) return false;
+
+	execute_job(job);
+	return true;
+}
+
+static void worker_main(void* arg)
+{
+	g_thread_index = (int) (size_t) arg;
+
+	while ( atomic_get(&g_running) )
+	{
+		if ( run_one() ) continue;
+
+		//push_job only posts when it sees a sleeper, so look once more after announcing
+		//ourselves. a job pushed before that is found here, one pushed after gets a post
+		atomic_add(&g_sleeping, 1);
+		if ( !run_one() ) semaphore_wait(g_wake, -1);
+		atomic_add(&g_sleeping, -1);
+	}
+}
+
+void _job_submit(job_func func, void* data, jobcounter_t* counter)
+{
+	//no pool to hand it to, run inline
+	if ( g_workers == NULL || (g_thread_index < 0 && g_num_workers == 1) )
+	{
+		func(data);
+		return;
+	}
+
+	if ( g_thread_index < 0 )
+	{
+		inject_job(func, data, counter);
+		return;
+	}
+
+	push_job( alloc_job(func, data, counter) );
+}
+
+void _job_submit_after(job_func func, void* data, jobcounter_t* dependency, jobcounter_t* counter)
+{
+	job_t* job;
+
+	if ( dependency == NULL )
+	{
+		_job_submit(func, data, counter);
+		return;
+	}
+
+	if ( g_workers == NULL || g_thread_index < 0 )
+	{
+		_job_wait(dependency);
+		func(data);
+		return;
+	}
+
+	job = alloc_job(func, data, counter);
+	job->dependency = dependency;
+
+	//the count is raised before checking the dependency so a concurrent release can't miss this job
+	mutex_lock(g_deferred_lock);
+	atomic_add(&g_num_deferred, 1);
+	if ( atomic_get(&dependency->pending) == 0 )
+	{
+		atomic_add(&g_num_deferred, -1);
+		mutex_unlock(g_deferred_lock);
+		push_job(job);
+		return;
+	}
+	job->next = g_deferred;
+	g_deferred = job;
+	mutex_unlock(g_deferred_lock);
+}
+
+void _job_parallel_for(job_range_func func, void* data, int count, int batch_size, jobcounter_t* counter)
+{
+	jobcounter_t local = {0};
+	int first;
+
+	if ( count <= 0 ) return;
+
+	if ( g_workers == NULL || g_thread_index < 0 )
+	{
+		func(data, 0, count);
+		return;
+	}
+
+	if ( batch_size <= 0 )
+	{
+		batch_size = count / (g_num_workers * 4);
+		if ( batch_size < 1 ) batch_size = 1;
+	}
+
+	for (first=0; first<count; first+=batch_size)
+	{
+		job_t* job = alloc_job(NULL, data, counter ? counter : &local);
+		job->range = func;
+		job->first = first;
+		job->last = first + batch_size < count ? first + batch_size : count;
+		push_job(job);
+	}
+
+	if ( counter == NULL ) _job_wait(&local);
+}
+
+void _job_wait(jobcounter_t* counter)
+{
+	if ( counter == NULL ) return;
+
+	while ( atomic_get(&counter->pending) > 0 )
+	{
+		if ( g_workers == NULL || g_thread_index < 0 || !run_one() ) thread_yield();
+	}
+}
+
+int _job_thread_count(void)
+{
+	return g_num_workers > 0 ? g_num_workers : 1;
+}
+
+bool init_job_lib(libutil_t* util, int num_threads)
+{
+	int i;
+
+	util->job_submit = _job_submit;
+	util->job_submit_after = _job_submit_after;
+	util->job_parallel_for = _job_parallel_for;
+	util->job_wait = _job_wait;
+	util->job_thread_count = _job_thread_count;
+
+	if ( num_threads == 0 ) num_threads = thread_cpu_count() - 1;
+	if ( num_threads < 0 ) num_threads = 0;
+	if ( num_threads > MAX_JOB_THREADS - 1 ) num_threads = MAX_JOB_THREADS - 1;
+
+	g_num_workers = num_threads + 1;
+	g_workers = (worker_t*) mem_calloc(g_num_workers, sizeof(worker_t), MEMORY_GENERAL);
+	if ( g_workers == NULL ) return false;
+
+	g_wake = semaphore_create();
+	g_deferred_lock = mutex_create();
+	g_deferred = NULL;
+	g_inject_lock = mutex_create();
+	g_injected = g_injected_tail = NULL;
+	atomic_set(&g_num_injected, 0);
+	g_thread_index = 0;
+	atomic_set(&g_running, 1);
+
+	for (i=0; i<g_num_workers; ++i)
+	{
+		g_workers[i].seed = 0x9E3779B9u * (unsigned int) (i + 1);
+	}
+
+	for (i=1; i<g_num_workers; ++i)
+	{
+		g_workers[i].thread = thread_create(worker_main, (void*) (size_t) i);
+	}
+
+	return true;
+}
+
+void shutdown_job_lib()
+{
+	int i;
+	if ( g_workers == NULL ) return;
+
+	//drain anything still queued on the main thread
+	while ( run_one() );
+
+	atomic_set(&g_running, 0);
+	semaphore_post(g_wake, g_num_workers);
+
+	for (i=1; i<g_num_workers; ++i)
+	{
+		if ( g_workers[i].thread ) thread_join(g_workers[i].thread);
+	}
+
+	semaphore_free(g_wake);
+	mutex_free(g_deferred_lock);
+	mutex_free(g_inject_lock);
+	mem_free(g_workers);
+
+	g_workers = NULL;
+	g_num_workers = 0;
+	g_deferred = NULL;
+	g_thread_index = -1;
+}
@@ -0,0 +1,8 @@
+#include "lib.h"
+
+extern bool init_job_lib(libutil_t* util, int num_threads);
+extern void shutdown_job_lib();
+
+extern void _job_submit(job_func func, void* data, jobcounter_t* counter);
+extern void _job_parallel_for(job_range_func func, void* data, int count, int batch_size, jobcounter_t* counter);
+extern void _job_wait(jobcounter_t* counter);
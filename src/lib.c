@@ -1,8 +1,25 @@
 #include <stdio.h>
+#include <string.h>
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include "lib.h"
 #include "draw.h"
+#include "glload.h"
+#include "job.h"
+#include "memory.h"
+#include "pack.h"
+#include "preload.h"
+#include "render.h"
+#include "spatial.h"
+
+//the dll / shared object only exports get_game_lib, static builds export nothing
+#if defined(_WIN32) && !defined(GAMELIB_STATIC)
+#define GAMELIB_EXPORT __declspec(dllexport)
+#elif defined(__GNUC__)
+#define GAMELIB_EXPORT __attribute__((visibility("default")))
+#else
+#define GAMELIB_EXPORT
+#endif
 
 static gamelib_t g_game_lib = {0};
 static libgfx_t g_gfx_lib = {0};
@@ -20,12 +37,28 @@ static callback_keyboard g_cb_keyboard = NULL;
 static GLFWwindow* window = NULL;
 static float g_time = 0.f;
 static float g_deltatime = 0.f;
+static inittimes_t g_init_times;
+
+#define MAX_MOUSE_SAMPLES 1024
+
+typedef struct
+{
+	bool coalesce;
+	bool raw;
+	bool moved;
+	bool has_position;
+	float x, y;
+	float dx, dy;
+	int num_samples;
+	mousesample_t samples[MAX_MOUSE_SAMPLES];
+} mousestate_t;
+
+static mousestate_t g_mouse;
 
 static void gl_reshape(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
-	glLoadIdentity();
-	glOrtho(0,width,height,0,-1,1);
+	if ( render_thread_active() ) render_thread_resize(width, height);
+	else set_viewport(width, height);
 
 	if ( g_cb_resize != NULL )
 	{
@@ -40,9 +73,64 @@ static void _mouse_button(GLFWwindow* window, int button, int action, int mods)
 
 static void _mouse_move(GLFWwindow* window, double x, double y)
 {
+	float dx = 0.f;
+	float dy = 0.f;
+
+	if ( g_mouse.has_position )
+	{
+		dx = (float) x - g_mouse.x;
+		dy = (float) y - g_mouse.y;
+	}
+
+	g_mouse.x = (float) x;
+	g_mouse.y = (float) y;
+	g_mouse.dx += dx;
+	g_mouse.dy += dy;
+	g_mouse.moved = true;
+	g_mouse.has_position = true;
+
+	if ( g_mouse.raw )
+	{
+		mousesample_t* sample;
+
+		//out of room, fold the motion into the last sample so the total is preserved
+		if ( g_mouse.num_samples == MAX_MOUSE_SAMPLES )
+		{
+			sample = &g_mouse.samples[MAX_MOUSE_SAMPLES-1];
+			sample->dx += dx;
+			sample->dy += dy;
+		}
+		else
+		{
+			sample = &g_mouse.samples[g_mouse.num_samples++];
+			sample->dx = dx;
+			sample->dy = dy;
+		}
+
+		sample->x = (float) x;
+		sample->y = (float) y;
+		sample->time = (float) glfwGetTime();
+	}
+
+	if ( g_mouse.coalesce ) return;
 	if ( g_cb_mousemove ) g_cb_mousemove((float) x, (float) y);
 }
 
+static void _poll_events(void)
+{
+	g_mouse.moved = false;
+	g_mouse.dx = 0.f;
+	g_mouse.dy = 0.f;
+	g_mouse.num_samples = 0;
+
+	glfwPollEvents();
+
+	if ( g_mouse.coalesce && g_mouse.moved && g_cb_mousemove )
+	{
+		g_cb_mousemove(g_mouse.x, g_mouse.y);
+	}
+}
+
 static void _mouse_enter(GLFWwindow* window, int enter)
 {
 	if ( g_cb_mouseenter ) g_cb_mouseenter(enter == GLFW_TRUE);
@@ -55,12 +143,24 @@ static void _keyboard(GLFWwindow* window, int key, int scan, int action, int mod
 
 static bool _init(const initparams_t* params)
 {
+	double start, phase, preload;
+
 	if ( !glfwInit() ) return false;
+	start = phase = glfwGetTime();
+	memset(&g_init_times, 0, sizeof(inittimes_t));
 
 	glfwWindowHint(GLFW_SAMPLES, 4);
 	glfwWindowHint(GLFW_DEPTH_BITS, 24);
 	glfwWindowHint(GLFW_DOUBLEBUFFER, 1);
 
+	if ( !params->gl_compat )
+	{
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+	}
+
 	g_cb_start = params->cb_start;
 	g_cb_loop = params->cb_loop;
 	g_cb_resize = params->cb_resize;
@@ -71,6 +171,22 @@ static bool _init(const initparams_t* params)
 	g_cb_mouseenter = params->cb_mouseenter;
 	g_cb_keyboard = params->cb_keyboard;
 
+	//assets decode on the job threads while the window and context are created
+	if ( !init_memory_lib(&g_util_lib, params->frame_memory, params->allocator) ) return false;
+	if ( !init_job_lib(&g_util_lib, params->job_threads) ) return false;
+	init_spatial_lib(&g_util_lib);
+	init_pack_lib(&g_util_lib);
+	init_font_cache();
+	if ( params->asset_pack && !_mount_pack(params->asset_pack) ) return false;
+
+	preload = glfwGetTime();
+	start_preload(params->preload_manifest);
+	phase = glfwGetTime();
+
+	memset(&g_mouse, 0, sizeof(mousestate_t));
+	g_mouse.coalesce = params->coalesce_mousemove;
+	g_mouse.raw = params->raw_mousemove;
+
 	window = glfwCreateWindow(
 		params->width, 
 		params->height, 
@@ -82,7 +198,6 @@ static bool _init(const initparams_t* params)
 	glfwSetCursorPosCallback(window, _mouse_move);
 	glfwSetCursorEnterCallback(window, _mouse_enter);
 	glfwSetKeyCallback(window, _keyboard);
-	gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
 
 	if ( !window )
 	{
@@ -90,12 +205,37 @@ static bool _init(const initparams_t* params)
 		return 1;
 	}
 
+	g_init_times.window = (float) (glfwGetTime() - phase) * 1000.f;
+	phase = glfwGetTime();
+
+	if ( !load_gl(window, params->gl_compat) ) return false;
+	g_init_times.gl_load = (float) (glfwGetTime() - phase) * 1000.f;
+	phase = glfwGetTime();
+
+	if ( g_mouse.raw )
+	{
+		glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+#ifdef GLFW_RAW_MOUSE_MOTION
+		if ( glfwRawMouseMotionSupported() )
+		{
+			glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+		}
+#endif
+	}
+
+	if ( !init_gfx_lib(&g_gfx_lib, params->gl_compat, params->texture_budget) ) return false;
 	gl_reshape(window, params->width, params->height);
+	g_init_times.gfx = (float) (glfwGetTime() - phase) * 1000.f;
+
+	finish_preload();
+	g_init_times.preload = (float) (glfwGetTime() - preload) * 1000.f;
 
-	init_gfx_lib(&g_gfx_lib);
 	g_game_lib.gfx = &g_gfx_lib;
 	g_game_lib.util = &g_util_lib;
 
+	if ( params->render_thread && !init_render_thread(&g_gfx_lib, window) ) return false;
+
+	g_init_times.total = (float) (glfwGetTime() - start) * 1000.f;
 	g_time = (float)glfwGetTime();
 	g_deltatime = 0.f;
 
@@ -110,15 +250,27 @@ static bool _update(void)
 	g_time = (float)glfwGetTime();
 	g_deltatime = g_time - last_time;
 
+	advance_frame_memory();
+
 	if ( !glfwWindowShouldClose(window) )
 	{
-		glClearColor(.1f, .15f, .3f, 1.f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if ( render_thread_active() )
+		{
+			if ( g_cb_loop && !g_cb_loop() ) return false;
+
+			//hand the recorded frame over, the render thread draws it while we run the next one
+			render_thread_submit();
+			_poll_events();
+			return true;
+		}
+
+		clear_frame();
 
 		if ( g_cb_loop && !g_cb_loop() ) return false;
 
+		end_frame();
 		glfwSwapBuffers(window);
-		glfwPollEvents();
+		_poll_events();
 		return true;
 	}
 
@@ -131,7 +283,13 @@ static void _shutdown(void)
 
 	g_game_lib.gfx = NULL;
 	g_game_lib.util = NULL;
+	shutdown_render_thread();
+	shutdown_preload();
 	shutdown_gfx_lib();
+	shutdown_font_cache();
+	shutdown_job_lib();
+	shutdown_memory_lib();
+	shutdown_pack_lib();
 
 	glfwTerminate();
 }
@@ -146,7 +304,24 @@ static float _get_deltatime(void)
 	return g_deltatime;
 }
 
-__declspec(dllexport) gamelib_t* get_game_lib(void)
+static const inittimes_t* _get_init_times(void)
+{
+	return &g_init_times;
+}
+
+static void _get_mouse_delta(float* dx, float* dy)
+{
+	if ( dx ) *dx = g_mouse.dx;
+	if ( dy ) *dy = g_mouse.dy;
+}
+
+static int _get_mouse_samples(const mousesample_t** samples)
+{
+	if ( samples ) *samples = g_mouse.samples;
+	return g_mouse.num_samples;
+}
+
+GAMELIB_EXPORT gamelib_t* get_game_lib(void)
 {
 	g_game_lib.init = _init;
 	g_game_lib.update = _update;
@@ -154,6 +329,9 @@ __declspec(dllexport) gamelib_t* get_game_lib(void)
 
 	g_util_lib.get_time = _get_time;
 	g_util_lib.get_deltatime = _get_deltatime;
+	g_util_lib.get_init_times = _get_init_times;
+	g_util_lib.get_mouse_delta = _get_mouse_delta;
+	g_util_lib.get_mouse_samples = _get_mouse_samples;
 
 	return &g_game_lib;
 }
\ No newline at end of file
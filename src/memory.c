@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "thread.h"
+
+#define DEFAULT_FRAME_BYTES (4 * 1024 * 1024)
+#define SCRATCH_BYTES (2 * 1024 * 1024)
+
+//two bump arenas, the one written this frame and the one from the previous frame,
+//so pointers handed out stay valid until the end of the next frame.
+//allocation is lock-free so jobs can use it too. the library's own scratch comes from a
+//second pair so it never eats into the budget the game asked for.
+typedef struct
+{
+	unsigned char* base;
+	volatile long long offset;
+} arena_t;
+
+//allocations are prefixed with their size and category so frees can be counted,
+//16 bytes keeps the caller's alignment
+typedef union
+{
+	struct
+	{
+		size_t size;
+		int category;
+	} info;
+	double align[2];
+} allocheader_t;
+
+static arena_t g_arenas[2];
+static int g_arena_size = 0;
+static arena_t g_scratch[2];
+static int g_current = 0;
+
+static void* default_alloc(void* user, size_t size) { return malloc(size); }
+static void* default_realloc(void* user, void* ptr, size_t size) { return realloc(ptr, size); }
+static void default_free(void* user, void* ptr) { free(ptr); }
+
+static allocator_t g_allocator = { default_alloc, default_realloc, default_free, NULL };
+static volatile long long g_bytes[MEMORY_CATEGORY_COUNT];
+static volatile long long g_peak[MEMORY_CATEGORY_COUNT];
+static volatile long long g_count[MEMORY_CATEGORY_COUNT];
+
+static void track(int category, long long bytes, int count)
+{
+	long long total = atomic_add(&g_bytes[category], bytes);
+	long long peak;
+
+	if ( count ) atomic_add(&g_count[category], count);
+
+	do
+	{
+		peak = atomic_get(&g_peak[category]);
+		if ( total <= peak ) return;
+	}
+	while ( !atomic_cas(&g_peak[category], peak, total) );
+}
+
+void* mem_alloc(size_t size, memorycategory_t category)
+{
+	allocheader_t* header = (allocheader_t*) g_allocator.alloc(g_allocator.user, sizeof(allocheader_t) + size);
+	if ( header == NULL ) return NULL;
+
+	header->info.size = size;
+	header->info.category = category;
+	track(category, (long long) size, 1);
+	return header + 1;
+}
+
+void* mem_calloc(size_t count, size_t size, memorycategory_t category)
+{
+	void* ptr = mem_alloc(count * size, category);
+	if ( ptr ) memset(ptr, 0, count * size);
+	return ptr;
+}
+
+//a block keeps the category it was first allocated with
+void* mem_realloc(void* ptr, size_t size, memorycategory_t category)
+{
+	allocheader_t* header;
+	size_t old_size;
+
+	if ( ptr == NULL ) return mem_alloc(size, category);
+
+	header = (allocheader_t*) ptr - 1;
+	old_size = header->info.size;
+	header = (allocheader_t*) g_allocator.realloc(g_allocator.user, header, sizeof(allocheader_t) + size);
+	if ( header == NULL ) return NULL;
+
+	header->info.size = size;
+	track(header->info.category, (long long) size - (long long) old_size, 0);
+	return header + 1;
+}
+
+void mem_free(void* ptr)
+{
+	allocheader_t* header;
+	if ( ptr == NULL ) return;
+
+	header = (allocheader_t*) ptr - 1;
+	track(header->info.category, -(long long) header->info.size, -1);
+	g_allocator.free(g_allocator.user, header);
+}
+
+void free_adopted(void* ptr)
+{
+	if ( ptr ) g_allocator.free(g_allocator.user, ptr);
+}
+
+void _get_memory_usage(memoryusage_t* usage)
+{
+	int i;
+	if ( usage == NULL ) return;
+
+	for (i=0; i<MEMORY_CATEGORY_COUNT; ++i)
+	{
+		usage->bytes[i] = atomic_get(&g_bytes[i]);
+		usage->peak_bytes[i] = atomic_get(&g_peak[i]);
+		usage->allocations[i] = atomic_get(&g_count[i]);
+	}
+}
+
+static void* arena_alloc(arena_t* arena, int arena_size, int size, int align)
+{
+	size_t base = (size_t) arena->base;
+	long long offset;
+	long long start;
+
+	if ( arena->base == NULL || size < 0 ) return NULL;
+	if ( align <= 0 ) align = 16;
+	if ( align & (align - 1) ) return NULL;
+
+	do
+	{
+		offset = atomic_get(&arena->offset);
+		start = (long long) (((base + (size_t) offset + (align - 1)) & ~((size_t) align - 1)) - base);
+		if ( start + size > arena_size ) return NULL;
+	}
+	while ( !atomic_cas(&arena->offset, offset, start + size) );
+
+	return arena->base + start;
+}
+
+void* _frame_alloc(int size, int align)
+{
+	return arena_alloc(&g_arenas[g_current], g_arena_size, size, align);
+}
+
+void* temp_alloc(int size)
+{
+	void* ptr = arena_alloc(&g_scratch[g_current], SCRATCH_BYTES, size, 16);
+	if ( ptr == NULL ) ptr = mem_alloc(size, MEMORY_FRAME);
+	return ptr;
+}
+
+void temp_free(void* ptr)
+{
+	int i;
+	for (i=0; i<2; ++i)
+	{
+		unsigned char* base = g_scratch[i].base;
+		if ( (unsigned char*) ptr >= base && (unsigned char*) ptr < base + SCRATCH_BYTES ) return;
+	}
+	mem_free(ptr);
+}
+
+void advance_frame_memory()
+{
+	g_current ^= 1;
+	atomic_set(&g_arenas[g_current].offset, 0);
+	atomic_set(&g_scratch[g_current].offset, 0);
+}
+
+//the allocator is kept after shutdown, blocks freed late still go back to it
+bool init_memory_lib(libutil_t* util, int frame_bytes, const allocator_t* allocator)
+{
+	int i;
+
+	util->frame_alloc = _frame_alloc;
+	util->get_memory_usage = _get_memory_usage;
+
+	if ( allocator ) g_allocator = *allocator;
+	else
+	{
+		g_allocator.alloc = default_alloc;
+		g_allocator.realloc = default_realloc;
+		g_allocator.free = default_free;
+		g_allocator.user = NULL;
+	}
+
+	g_arena_size = frame_bytes > 0 ? frame_bytes : DEFAULT_FRAME_BYTES;
+	g_current = 0;
+
+	for (i=0; i<2; ++i)
+	{
+		g_arenas[i].base = (unsigned char*) mem_alloc(g_arena_size, MEMORY_FRAME);
+		g_arenas[i].offset = 0;
+		g_scratch[i].base = (unsigned char*) mem_alloc(SCRATCH_BYTES, MEMORY_FRAME);
+		g_scratch[i].offset = 0;
+		if ( g_arenas[i].base == NULL || g_scratch[i].base == NULL ) return false;
+	}
+
+	return true;
+}
+
+void shutdown_memory_lib()
+{
+	int i;
+	for (i=0; i<2; ++i)
+	{
+		mem_free(g_arenas[i].base);
+		mem_free(g_scratch[i].base);
+		g_arenas[i].base = NULL;
+		g_scratch[i].base = NULL;
+	}
+	g_arena_size = 0;
+}
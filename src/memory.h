@@ -0,0 +1,22 @@
+#include "lib.h"
+
+extern bool init_memory_lib(libutil_t* util, int frame_bytes, const allocator_t* allocator);
+extern void shutdown_memory_lib();
+extern void advance_frame_memory();
+
+extern void* _frame_alloc(int size, int align);
+extern void _get_memory_usage(memoryusage_t* usage);
+
+//every heap allocation in the library goes through these so the user's allocator sees it
+//and the category counters stay exact
+extern void* mem_alloc(size_t size, memorycategory_t category);
+extern void* mem_calloc(size_t count, size_t size, memorycategory_t category);
+extern void* mem_realloc(void* ptr, size_t size, memorycategory_t category);
+extern void mem_free(void* ptr);
+//buffers handed over with adopt came straight from the allocator, without our header
+extern void free_adopted(void* ptr);
+
+//scratch memory for internal use, served from arenas kept apart from frame_alloc and
+//falling back to the heap
+extern void* temp_alloc(int size);
+extern void temp_free(void* ptr);
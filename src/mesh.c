@@ -0,0 +1,129 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "draw.h"
+#include "glstate.h"
+#include "memory.h"
+#include "stats.h"
+
+typedef struct
+{
+	GLuint vao;
+	GLuint vbo;
+	GLuint ibo;
+	int num_vertices;
+	int num_indices;
+} meshdata_t;
+
+//immutable storage where the driver has it, the data never changes after upload
+static void upload_static(GLenum target, GLsizeiptr size, const void* data)
+{
+	g_frame_stats.bytes_uploaded += size;
+	if ( GLAD_GL_ARB_buffer_storage ) glBufferStorage(target, size, data, 0);
+	else glBufferData(target, size, data, GL_STATIC_DRAW);
+}
+
+mesh_t _create_mesh(const colorvertex_t* vertices, int num_vertices, const unsigned int* indices, int num_indices)
+{
+	meshdata_t* mesh;
+	if ( vertices == NULL || indices == NULL || num_vertices <= 0 || num_indices <= 0 ) return NULL;
+
+	flush_batch(FLUSH_RESOURCE);
+
+	mesh = (meshdata_t*) mem_alloc(sizeof(meshdata_t), MEMORY_GEOMETRY);
+	memset(mesh, 0, sizeof(meshdata_t));
+	mesh->num_vertices = num_vertices;
+	mesh->num_indices = num_indices;
+
+	if ( !gfx_compat() )
+	{
+		glGenVertexArrays(1, &mesh->vao);
+		gl_bind_vertex_array(mesh->vao);
+	}
+
+	glGenBuffers(1, &mesh->vbo);
+	gl_bind_buffer(GL_ARRAY_BUFFER, mesh->vbo);
+	upload_static(GL_ARRAY_BUFFER, sizeof(colorvertex_t) * num_vertices, vertices);
+
+	glGenBuffers(1, &mesh->ibo);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+	upload_static(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * num_indices, indices);
+
+	if ( !gfx_compat() )
+	{
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(colorvertex_t), (void*) 0);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(colorvertex_t), (void*) (sizeof(float) * 2));
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(colorvertex_t), (void*) (sizeof(float) * 4));
+	}
+
+	return mesh;
+}
+
+void _free_mesh(mesh_t mesh)
+{
+	meshdata_t* data = (meshdata_t*) mesh;
+	if ( data == NULL ) return;
+
+	flush_batch(FLUSH_RESOURCE);
+	gl_delete_buffer(data->vbo);
+	gl_delete_buffer(data->ibo);
+	if ( data->vao ) gl_delete_vertex_array(data->vao);
+	mem_free(data);
+}
+
+static void transform_to_matrix(float* out, const transform_t* transform)
+{
+	memset(out, 0, sizeof(float) * 16);
+	out[0] = transform->m[0];
+	out[1] = transform->m[1];
+	out[4] = transform->m[2];
+	out[5] = transform->m[3];
+	out[10] = 1.f;
+	out[12] = transform->m[4];
+	out[13] = transform->m[5];
+	out[15] = 1.f;
+}
+
+void _draw_mesh(mesh_t mesh, const transform_t* transform)
+{
+	meshdata_t* data = (meshdata_t*) mesh;
+	float model[16];
+	if ( data == NULL ) return;
+
+	flush_batch(FLUSH_DRAW);
+	if ( transform ) transform_to_matrix(model, transform);
+
+	g_frame_stats.draw_calls++;
+	g_frame_stats.vertices += data->num_vertices;
+	g_frame_stats.indices += data->num_indices;
+
+	if ( !gfx_compat() )
+	{
+		bind_program(transform ? model : NULL);
+		gl_bind_vertex_array(data->vao);
+		glDrawElements(GL_TRIANGLES, data->num_indices, GL_UNSIGNED_INT, 0);
+		return;
+	}
+
+	glPushMatrix();
+	if ( transform ) glMultMatrixf(model);
+
+	apply_texture();
+	gl_bind_buffer(GL_ARRAY_BUFFER, data->vbo);
+	gl_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, data->ibo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(colorvertex_t), (void*) 0);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(colorvertex_t), (void*) (sizeof(float) * 2));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(colorvertex_t), (void*) (sizeof(float) * 4));
+	glDrawElements(GL_TRIANGLES, data->num_indices, GL_UNSIGNED_INT, 0);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_COLOR_ARRAY);
+
+	glPopMatrix();
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pack.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//archives are mapped read-only for the life of the library, lookups binary search the
+//index and hand out pointers straight into the mapping
+#define MAX_PACKS 8
+
+typedef struct
+{
+	const unsigned char* base;
+	unsigned long long size;
+	const packheader_t* header;
+	const packentry_t* entries;
+	const char* names;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+} packdata_t;
+
+static packdata_t g_packs[MAX_PACKS];
+static int g_num_packs = 0;
+
+static void unmap_pack(packdata_t* pack)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(pack->base);
+	CloseHandle(pack->mapping);
+	CloseHandle(pack->file);
+#else
+	munmap((void*) pack->base, (size_t) pack->size);
+#endif
+	memset(pack, 0, sizeof(packdata_t));
+}
+
+static bool map_pack(packdata_t* pack, const char* filename)
+{
+#ifdef _WIN32
+	LARGE_INTEGER size;
+
+	pack->file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if ( pack->file == INVALID_HANDLE_VALUE ) return false;
+
+	GetFileSizeEx(pack->file, &size);
+	pack->size = (unsigned long long) size.QuadPart;
+	pack->mapping = CreateFileMappingA(pack->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	pack->base = pack->mapping ? (const unsigned char*) MapViewOfFile(pack->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+	if ( pack->base == NULL )
+	{
+		if ( pack->mapping ) CloseHandle(pack->mapping);
+		CloseHandle(pack->file);
+		return false;
+	}
+	return true;
+#else
+	struct stat info;
+	void* base;
+	int fd = open(filename, O_RDONLY);
+	if ( fd < 0 ) return false;
+
+	if ( fstat(fd, &info) != 0 || info.st_size == 0 )
+	{
+		close(fd);
+		return false;
+	}
+
+	base = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if ( base == MAP_FAILED ) return false;
+
+	pack->base = (const unsigned char*) base;
+	pack->size = (unsigned long long) info.st_size;
+	return true;
+#endif
+}
+
+static bool validate_pack(packdata_t* pack)
+{
+	unsigned long long index_end;
+	unsigned int i;
+
+	if ( pack->size < sizeof(packheader_t) ) return false;
+
+	pack->header = (const packheader_t*) pack->base;
+	if ( pack->header->magic != PACK_MAGIC || pack->header->version != PACK_VERSION ) return false;
+
+	index_end = sizeof(packheader_t) + (unsigned long long) pack->header->num_entries * sizeof(packentry_t);
+	if ( index_end > pack->size || pack->header->names_offset < index_end || pack->header->names_offset > pack->size ) return false;
+
+	pack->entries = (const packentry_t*) (pack->base + sizeof(packheader_t));
+	pack->names = (const char*) (pack->base + pack->header->names_offset);
+
+	for (i=0; i<pack->header->num_entries; ++i)
+	{
+		const packentry_t* entry = &pack->entries[i];
+		if ( entry->offset > pack->size || entry->size > pack->size - entry->offset ) return false;
+		if ( pack->header->names_offset + (unsigned long long) entry->name_offset >= pack->size ) return false;
+	}
+
+	return true;
+}
+
+bool _mount_pack(const char* filename)
+{
+	packdata_t* pack;
+
+	if ( g_num_packs == MAX_PACKS )
+	{
+		printf("TOO MANY PACKS %s\n", filename);
+		return false;
+	}
+
+	pack = &g_packs[g_num_packs];
+	memset(pack, 0, sizeof(packdata_t));
+
+	if ( !map_pack(pack, filename) )
+	{
+		printf("CAN'T FIND %s\n", filename);
+		return false;
+	}
+
+	if ( !validate_pack(pack) )
+	{
+		printf("BAD PACK %s\n", filename);
+		unmap_pack(pack);
+		return false;
+	}
+
+	printf("MOUNT %s : %u files\n", filename, pack->header->num_entries);
+	g_num_packs++;
+	return true;
+}
+
+static const packentry_t* find_entry(const packdata_t* pack, unsigned int hash, const char* name)
+{
+	int low = 0;
+	int high = (int) pack->header->num_entries - 1;
+
+	//find the first entry with the hash, then walk any collisions
+	while ( low < high )
+	{
+		int mid = (low + high) / 2;
+		if ( pack->entries[mid].hash < hash ) low = mid + 1;
+		else high = mid;
+	}
+
+	for (; low<(int) pack->header->num_entries && pack->entries[low].hash == hash; ++low)
+	{
+		if ( strcmp(pack->names + pack->entries[low].name_offset, name) == 0 ) return &pack->entries[low];
+	}
+
+	return NULL;
+}
+
+//later mounts shadow earlier ones
+const void* pack_find(const char* filename, int* size)
+{
+	char name[PACK_MAX_PATH];
+	unsigned int hash;
+	int i;
+
+	if ( g_num_packs == 0 || filename == NULL ) return NULL;
+
+	pack_normalize(name, filename);
+	hash = pack_hash(name);
+
+	for (i=g_num_packs-1; i>=0; --i)
+	{
+		const packentry_t* entry = find_entry(&g_packs[i], hash, name);
+		if ( entry )
+		{
+			*size = (int) entry->size;
+			return g_packs[i].base + entry->offset;
+		}
+	}
+
+	return NULL;
+}
+
+void init_pack_lib(libutil_t* util)
+{
+	util->mount_pack = _mount_pack;
+}
+
+void shutdown_pack_lib()
+{
+	while ( g_num_packs > 0 ) unmap_pack(&g_packs[--g_num_packs]);
+}
@@ -0,0 +1,62 @@
+#ifndef GAMELIB_PACK_H
+#define GAMELIB_PACK_H
+
+#include <ctype.h>
+#include "lib.h"
+
+//asset archive layout, shared with tools/packer.c. a header, then the index sorted by hash,
+//then the NUL terminated names, then the file contents each starting on a PACK_ALIGN boundary
+#define PACK_MAGIC 0x4B415047 //"GPAK"
+#define PACK_VERSION 1
+#define PACK_ALIGN 64
+#define PACK_MAX_PATH 260
+
+typedef struct
+{
+	unsigned int magic;
+	unsigned int version;
+	unsigned int num_entries;
+	unsigned int names_offset;
+} packheader_t;
+
+typedef struct
+{
+	unsigned int hash;
+	unsigned int name_offset; //into the names block
+	unsigned long long offset; //from the start of the archive
+	unsigned long long size;
+} packentry_t;
+
+//names are stored lowercase with forward slashes and no leading ./ so lookups match however
+//the game spells the path
+static inline void pack_normalize(char* out, const char* path)
+{
+	int i = 0;
+	while ( path[0] == '.' && (path[1] == '/' || path[1] == '\\') ) path += 2;
+
+	for (; *path && i<PACK_MAX_PATH-1; ++path)
+	{
+		out[i++] = *path == '\\' ? '/' : (char) tolower((unsigned char) *path);
+	}
+	out[i] = 0;
+}
+
+static inline unsigned int pack_hash(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	while ( *name )
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+extern void init_pack_lib(libutil_t* util);
+extern void shutdown_pack_lib();
+extern bool _mount_pack(const char* filename);
+
+//the file's contents inside a mounted archive, NULL if no archive has it
+extern const void* pack_find(const char* filename, int* size);
+
+#endif //GAMELIB_PACK_H
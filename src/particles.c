@@ -0,0 +1,373 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "draw.h"
+#include "glstate.h"
+#include "job.h"
+#include "memory.h"
+#include "stats.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE__)
+#include <xmmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+#define CURVE_SAMPLES 64
+#define PARTICLE_BATCH 8192 //particles per job, a multiple of 4
+
+//structure of arrays, each array is 16 byte aligned and padded to a multiple of 4 so the
+//update can run 4 particles at a time. a particle is dead once age * inv_life reaches 1
+typedef struct
+{
+	int count;
+	int max_particles;
+	float* x;
+	float* y;
+	float* vx;
+	float* vy;
+	float* age;
+	float* inv_life;
+	void* memory;
+	particleparams_t params;
+	float size_curve[CURVE_SAMPLES];
+	color_t color_curve[CURVE_SAMPLES];
+	unsigned int seed;
+	GLuint vao;
+	GLuint vbo;
+	particleinstance_t* staging[2]; //render thread copies, one per frame in flight
+	float dt; //job arguments
+	float damping;
+	particleinstance_t* fill;
+} particlesdata_t;
+
+static float random_float(particlesdata_t* p)
+{
+	p->seed ^= p->seed << 13;
+	p->seed ^= p->seed >> 17;
+	p->seed ^= p->seed << 5;
+	return (p->seed >> 8) * (1.f / 16777216.f);
+}
+
+static color_t lerp_color(color_t a, color_t b, float t)
+{
+	color_t result = 0;
+	int shift;
+	for (shift=0; shift<32; shift+=8)
+	{
+		float ca = (float) ((a >> shift) & 0xFF);
+		float cb = (float) ((b >> shift) & 0xFF);
+		result |= ((color_t) (ca + (cb - ca) * t + .5f) & 0xFF) << shift;
+	}
+	return result;
+}
+
+particles_t _create_particles(int max_particles, const particleparams_t* params)
+{
+	particlesdata_t* p;
+	size_t array_bytes;
+	char* base;
+	int i;
+
+	if ( max_particles <= 0 || params == NULL ) return NULL;
+
+	p = (particlesdata_t*) mem_alloc(sizeof(particlesdata_t), MEMORY_PARTICLES);
+	memset(p, 0, sizeof(particlesdata_t));
+	p->max_particles = max_particles;
+	p->params = *params;
+	p->seed = 0x9E3779B9u;
+
+	array_bytes = sizeof(float) * ((max_particles + 3) & ~3);
+	p->memory = mem_alloc(array_bytes * 6 + 15, MEMORY_PARTICLES);
+	if ( p->memory == NULL )
+	{
+		mem_free(p);
+		return NULL;
+	}
+	memset(p->memory, 0, array_bytes * 6 + 15);
+
+	base = (char*) (((size_t) p->memory + 15) & ~(size_t) 15);
+	p->x = (float*) (base);
+	p->y = (float*) (base + array_bytes);
+	p->vx = (float*) (base + array_bytes * 2);
+	p->vy = (float*) (base + array_bytes * 3);
+	p->age = (float*) (base + array_bytes * 4);
+	p->inv_life = (float*) (base + array_bytes * 5);
+
+	for (i=0; i<CURVE_SAMPLES; ++i)
+	{
+		float t = (float) i / (CURVE_SAMPLES - 1);
+		p->size_curve[i] = params->start_size + (params->end_size - params->start_size) * t;
+		p->color_curve[i] = lerp_color(params->start_color, params->end_color, t);
+	}
+
+	if ( !gfx_compat() )
+	{
+		glGenVertexArrays(1, &p->vao);
+		gl_bind_vertex_array(p->vao);
+		glGenBuffers(1, &p->vbo);
+		gl_bind_buffer(GL_ARRAY_BUFFER, p->vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(particleinstance_t) * max_particles, NULL, GL_STREAM_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(particleinstance_t), (void*) 0);
+		glVertexAttribDivisor(0, 1);
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(particleinstance_t), (void*) (sizeof(float) * 3));
+		glVertexAttribDivisor(1, 1);
+	}
+
+	return p;
+}
+
+void _free_particles(particles_t particles)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+	if ( p == NULL ) return;
+
+	if ( p->vao )
+	{
+		gl_delete_buffer(p->vbo);
+		gl_delete_vertex_array(p->vao);
+	}
+
+	mem_free(p->staging[0]);
+	mem_free(p->staging[1]);
+	mem_free(p->memory);
+	mem_free(p);
+}
+
+void _emit_particles(particles_t particles, int count, const particleemit_t* emit)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+	int i;
+
+	if ( count > p->max_particles - p->count ) count = p->max_particles - p->count;
+
+	for (i=0; i<count; ++i)
+	{
+		int n = p->count;
+		float angle = emit->angle + (random_float(p) - .5f) * emit->spread;
+		float speed = emit->min_speed + (emit->max_speed - emit->min_speed) * random_float(p);
+		float life = emit->min_life + (emit->max_life - emit->min_life) * random_float(p);
+		if ( life <= 0.f ) continue;
+
+		p->x[n] = emit->x;
+		p->y[n] = emit->y;
+		p->vx[n] = cosf(angle) * speed;
+		p->vy[n] = sinf(angle) * speed;
+		p->age[n] = 0.f;
+		p->inv_life[n] = 1.f / life;
+		p->count++;
+	}
+}
+
+//first and last count blocks of 4, the padding past count is integrated along with the rest
+static void update_range(void* data, int first, int last)
+{
+	particlesdata_t* p = (particlesdata_t*) data;
+	float dt = p->dt;
+	float damping = p->damping;
+	float gx = p->params.gravity_x * dt;
+	float gy = p->params.gravity_y * dt;
+	int i = first * 4;
+	int end = last * 4;
+
+#ifdef PARTICLES_SSE
+	__m128 dt4 = _mm_set1_ps(dt);
+	__m128 damping4 = _mm_set1_ps(damping);
+	__m128 gx4 = _mm_set1_ps(gx);
+	__m128 gy4 = _mm_set1_ps(gy);
+
+	for (; i<end; i+=4)
+	{
+		__m128 vx = _mm_add_ps(_mm_mul_ps(_mm_load_ps(p->vx + i), damping4), gx4);
+		__m128 vy = _mm_add_ps(_mm_mul_ps(_mm_load_ps(p->vy + i), damping4), gy4);
+		_mm_store_ps(p->vx + i, vx);
+		_mm_store_ps(p->vy + i, vy);
+		_mm_store_ps(p->x + i, _mm_add_ps(_mm_load_ps(p->x + i), _mm_mul_ps(vx, dt4)));
+		_mm_store_ps(p->y + i, _mm_add_ps(_mm_load_ps(p->y + i), _mm_mul_ps(vy, dt4)));
+		_mm_store_ps(p->age + i, _mm_add_ps(_mm_load_ps(p->age + i), dt4));
+	}
+#endif
+
+	for (; i<end; ++i)
+	{
+		p->vx[i] = p->vx[i] * damping + gx;
+		p->vy[i] = p->vy[i] * damping + gy;
+		p->x[i] += p->vx[i] * dt;
+		p->y[i] += p->vy[i] * dt;
+		p->age[i] += dt;
+	}
+}
+
+void _update_particles(particles_t particles, float dt)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+	int i;
+
+	if ( p->count == 0 ) return;
+
+	p->dt = dt;
+	p->damping = 1.f - p->params.drag * dt;
+	if ( p->damping < 0.f ) p->damping = 0.f;
+
+	_job_parallel_for(update_range, p, (p->count + 3) / 4, PARTICLE_BATCH / 4, NULL);
+
+	//swap the last live particle into each dead slot
+	i = 0;
+	while ( i < p->count )
+	{
+		int last;
+		if ( p->age[i] * p->inv_life[i] < 1.f )
+		{
+			++i;
+			continue;
+		}
+
+		last = --p->count;
+		p->x[i] = p->x[last];
+		p->y[i] = p->y[last];
+		p->vx[i] = p->vx[last];
+		p->vy[i] = p->vy[last];
+		p->age[i] = p->age[last];
+		p->inv_life[i] = p->inv_life[last];
+	}
+}
+
+int _particle_count(particles_t particles)
+{
+	return particles ? ((particlesdata_t*) particles)->count : 0;
+}
+
+static void fill_range(void* data, int first, int last)
+{
+	particlesdata_t* p = (particlesdata_t*) data;
+	particleinstance_t* out = p->fill;
+	int i;
+
+	for (i=first; i<last; ++i)
+	{
+		int sample = (int) (p->age[i] * p->inv_life[i] * (CURVE_SAMPLES - 1));
+		if ( sample > CURVE_SAMPLES - 1 ) sample = CURVE_SAMPLES - 1;
+
+		out[i].x = p->x[i];
+		out[i].y = p->y[i];
+		out[i].size = p->size_curve[sample];
+		out[i].color = p->color_curve[sample];
+	}
+}
+
+static void fill_instances(particlesdata_t* p, particleinstance_t* out)
+{
+	p->fill = out;
+	_job_parallel_for(fill_range, p, p->count, PARTICLE_BATCH, NULL);
+}
+
+//fixed function fallback, expands each instance into a quad
+static void emit_instances(const particleinstance_t* instances, int count)
+{
+	colorvertex_t chunk[256];
+	int i;
+
+	while ( count > 0 )
+	{
+		int n = count < 64 ? count : 64;
+		for (i=0; i<n; ++i)
+		{
+			const particleinstance_t* in = instances + i;
+			float half = in->size * .5f;
+			build_rect(chunk + i * 4, in->x - half, in->y - half, in->size, in->size, in->color);
+		}
+		emit_vertices(chunk, n * 4, false);
+		instances += n;
+		count -= n;
+	}
+}
+
+static void draw_instances(particlesdata_t* p, int count)
+{
+	bind_particle_program();
+	g_frame_stats.draw_calls++;
+	g_frame_stats.vertices += count * 4;
+	g_frame_stats.bytes_uploaded += sizeof(particleinstance_t) * count;
+
+	gl_bind_vertex_array(p->vao);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
+
+void _draw_particles(particles_t particles)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+	particleinstance_t* instances;
+	texture_t saved;
+
+	if ( p == NULL || p->count == 0 ) return;
+
+	saved = current_texture();
+	_set_texture(p->params.texture);
+	flush_batch(FLUSH_DRAW);
+
+	if ( gfx_compat() )
+	{
+		instances = (particleinstance_t*) temp_alloc(sizeof(particleinstance_t) * p->count);
+		fill_instances(p, instances);
+		emit_instances(instances, p->count);
+		temp_free(instances);
+	}
+	else
+	{
+		//the instance data is written straight into the buffer, invalidating it avoids a stall
+		gl_bind_buffer(GL_ARRAY_BUFFER, p->vbo);
+		instances = (particleinstance_t*) glMapBufferRange(GL_ARRAY_BUFFER, 0, sizeof(particleinstance_t) * p->count, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		if ( instances )
+		{
+			fill_instances(p, instances);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			draw_instances(p, p->count);
+		}
+	}
+
+	_set_texture(saved);
+}
+
+//render thread support, the game thread fills a copy and the render thread uploads it
+const particleinstance_t* stage_particles(particles_t particles, int slot, int* count)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+
+	*count = p->count;
+	if ( p->count == 0 ) return NULL;
+
+	if ( p->staging[slot] == NULL )
+	{
+		p->staging[slot] = (particleinstance_t*) mem_alloc(sizeof(particleinstance_t) * p->max_particles, MEMORY_PARTICLES);
+	}
+
+	fill_instances(p, p->staging[slot]);
+	return p->staging[slot];
+}
+
+void draw_particle_instances(particles_t particles, const particleinstance_t* instances, int count)
+{
+	particlesdata_t* p = (particlesdata_t*) particles;
+	texture_t saved;
+
+	if ( p == NULL || count == 0 ) return;
+
+	saved = current_texture();
+	_set_texture(p->params.texture);
+	flush_batch(FLUSH_DRAW);
+
+	if ( gfx_compat() )
+	{
+		emit_instances(instances, count);
+	}
+	else
+	{
+		gl_bind_buffer(GL_ARRAY_BUFFER, p->vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(particleinstance_t) * p->max_particles, NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(particleinstance_t) * count, instances);
+		draw_instances(p, count);
+	}
+
+	_set_texture(saved);
+}
@@ -0,0 +1,166 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "job.h"
+#include "memory.h"
+#include "preload.h"
+
+#define MAX_PRELOAD_PATH 260
+
+typedef struct
+{
+	char filename[MAX_PRELOAD_PATH];
+	bool is_font;
+	bool claimed;
+	void* pixels;
+	int width;
+	int height;
+	bakedfont_t* baked;
+	texture_t texture;
+	font_t font;
+} preloadasset_t;
+
+static preloadasset_t* g_assets = NULL;
+static int g_num_assets = 0;
+static jobcounter_t g_counter;
+
+static bool has_extension(const char* filename, const char* extension)
+{
+	size_t length = strlen(filename);
+	size_t ext_length = strlen(extension);
+	size_t i;
+
+	if ( length < ext_length ) return false;
+	for (i=0; i<ext_length; ++i)
+	{
+		if ( tolower((unsigned char) filename[length - ext_length + i]) != extension[i] ) return false;
+	}
+	return true;
+}
+
+static void decode_asset(void* data)
+{
+	preloadasset_t* asset = (preloadasset_t*) data;
+
+	if ( asset->is_font ) asset->baked = bake_font(asset->filename, 0, NULL);
+	else asset->pixels = decode_texture(asset->filename, &asset->width, &asset->height);
+}
+
+//one file per line, blank lines and lines starting with # are skipped. .ttf and .otf files
+//are fonts, everything else is a texture
+void start_preload(const char* manifest)
+{
+	char line[MAX_PRELOAD_PATH];
+	int max_assets = 0;
+	int i;
+	FILE* fp;
+
+	memset(&g_counter, 0, sizeof(jobcounter_t));
+	if ( manifest == NULL ) return;
+
+	fp = fopen(manifest, "r");
+	if ( !fp )
+	{
+		printf("CAN'T FIND %s\n", manifest);
+		return;
+	}
+
+	while ( fgets(line, sizeof(line), fp) )
+	{
+		char* start = line;
+		char* end = line + strlen(line);
+		preloadasset_t* asset;
+
+		while ( *start && isspace((unsigned char) *start) ) ++start;
+		while ( end > start && isspace((unsigned char) end[-1]) ) --end;
+		*end = 0;
+		if ( *start == 0 || *start == '#' ) continue;
+
+		if ( g_num_assets == max_assets )
+		{
+			max_assets = max_assets ? max_assets * 2 : 32;
+			g_assets = (preloadasset_t*) mem_realloc(g_assets, sizeof(preloadasset_t) * max_assets, MEMORY_GENERAL);
+		}
+
+		asset = &g_assets[g_num_assets++];
+		memset(asset, 0, sizeof(preloadasset_t));
+		strcpy(asset->filename, start);
+		asset->is_font = has_extension(start, ".ttf") || has_extension(start, ".otf");
+	}
+
+	fclose(fp);
+
+	//submitted after parsing so the array no longer moves under the jobs
+	for (i=0; i<g_num_assets; ++i)
+	{
+		_job_submit(decode_asset, &g_assets[i], &g_counter);
+	}
+}
+
+void finish_preload(void)
+{
+	int i;
+
+	_job_wait(&g_counter);
+
+	for (i=0; i<g_num_assets; ++i)
+	{
+		preloadasset_t* asset = &g_assets[i];
+
+		if ( asset->is_font ) asset->font = upload_font(asset->baked);
+		else if ( asset->pixels ) asset->texture = upload_texture(asset->pixels, asset->width, asset->height);
+
+		asset->pixels = NULL;
+		asset->baked = NULL;
+	}
+}
+
+void shutdown_preload(void)
+{
+	int i;
+
+	for (i=0; i<g_num_assets; ++i)
+	{
+		preloadasset_t* asset = &g_assets[i];
+		if ( asset->claimed ) continue;
+
+		if ( asset->texture ) _free_texture(asset->texture);
+		if ( asset->font ) _free_font(asset->font);
+	}
+
+	mem_free(g_assets);
+	g_assets = NULL;
+	g_num_assets = 0;
+}
+
+static preloadasset_t* find_asset(const char* filename, bool is_font)
+{
+	int i;
+	for (i=0; i<g_num_assets; ++i)
+	{
+		preloadasset_t* asset = &g_assets[i];
+		if ( asset->claimed || asset->is_font != is_font ) continue;
+		if ( strcmp(asset->filename, filename) == 0 ) return asset;
+	}
+	return NULL;
+}
+
+texture_t take_preloaded_texture(const char* filename)
+{
+	preloadasset_t* asset = find_asset(filename, false);
+	if ( asset == NULL || asset->texture == 0 ) return 0;
+
+	asset->claimed = true;
+	return asset->texture;
+}
+
+font_t take_preloaded_font(const char* filename)
+{
+	preloadasset_t* asset = find_asset(filename, true);
+	if ( asset == NULL || asset->font == NULL ) return NULL;
+
+	asset->claimed = true;
+	return asset->font;
+}
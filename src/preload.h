@@ -0,0 +1,10 @@
+#include "lib.h"
+
+//reads a manifest and decodes its assets on the job threads, uploads happen in finish_preload
+extern void start_preload(const char* manifest);
+extern void finish_preload(void);
+extern void shutdown_preload(void);
+
+//hands out a preloaded asset once, later loads of the same file go to disk again
+extern texture_t take_preloaded_texture(const char* filename);
+extern font_t take_preloaded_font(const char* filename);
@@ -0,0 +1,527 @@
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include "render.h"
+#include "draw.h"
+#include "memory.h"
+#include "thread.h"
+
+//in threaded mode gfx calls are recorded into one of two frame lists on the game thread.
+//the render thread owns the GL context and draws the previous frame's list while the
+//next one is recorded. anything that must return a GL object runs as a blocking call,
+//frees wait until the frame they were recorded in has been drawn.
+
+typedef void (*render_func)(void* arg);
+
+static GLFWwindow* g_window = NULL;
+static thread_t g_thread = NULL;
+static drawlist_t g_frames[2];
+static int g_recording = 0;
+static volatile long long g_running = 0;
+static volatile long long g_frame_pending = 0;
+static volatile long long g_resize_pending = 0;
+static volatile long long g_width = 0;
+static volatile long long g_height = 0;
+static semaphore_t g_wake = NULL;
+static semaphore_t g_frame_done = NULL;
+static semaphore_t g_call_done = NULL;
+static mutex_t g_call_lock = NULL;
+static render_func g_call = NULL;
+static void* g_call_arg = NULL;
+
+static void run_frees(int frame);
+
+static void render_main(void* arg)
+{
+	glfwMakeContextCurrent(g_window);
+
+	while ( atomic_get(&g_running) )
+	{
+		semaphore_wait(g_wake, -1);
+
+		if ( g_call )
+		{
+			g_call(g_call_arg);
+			g_call = NULL;
+			semaphore_post(g_call_done, 1);
+		}
+
+		if ( atomic_get(&g_frame_pending) )
+		{
+			int index = g_recording ^ 1;
+			drawlist_t frame = g_frames[index];
+
+			if ( atomic_cas(&g_resize_pending, 1, 0) )
+			{
+				set_viewport((int) atomic_get(&g_width), (int) atomic_get(&g_height));
+			}
+
+			clear_frame();
+			_submit_drawlists(&frame, 1);
+			end_frame();
+			run_frees(index);
+			glfwSwapBuffers(g_window);
+
+			atomic_set(&g_frame_pending, 0);
+			semaphore_post(g_frame_done, 1);
+		}
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+//runs func on the render thread and blocks until it returns
+static void render_call(render_func func, void* arg)
+{
+	mutex_lock(g_call_lock);
+	g_call_arg = arg;
+	g_call = func;
+	semaphore_post(g_wake, 1);
+	semaphore_wait(g_call_done, -1);
+	mutex_unlock(g_call_lock);
+}
+
+typedef struct
+{
+	const char* filename;
+	const char* filename2;
+	texture_t texture;
+	font_t font;
+	shader_t shader;
+	rendertarget_t target;
+	int width;
+	int height;
+	mesh_t mesh;
+	const colorvertex_t* vertices;
+	const unsigned int* indices;
+	tilemap_t tilemap;
+	particles_t particles;
+	const particleparams_t* particle_params;
+	const fontoptions_t* font_options;
+	textureformat_t format;
+	const void* buffer;
+	bool adopt;
+} resourcecall_t;
+
+static void call_load_texture(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->texture = _load_texture(call->filename); }
+static void call_load_font(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->font = _load_font(call->filename); }
+static void call_load_font_ex(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->font = _load_font_ex(call->filename, call->width, call->font_options); }
+static void call_free_texture(void* arg) { _free_texture(((resourcecall_t*) arg)->texture); }
+static void call_free_font(void* arg) { _free_font(((resourcecall_t*) arg)->font); }
+static void call_load_shader(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->shader = _load_shader(call->filename, call->filename2); }
+static void call_create_shader(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->shader = _create_shader(call->filename, call->filename2); }
+static void call_free_shader(void* arg) { _free_shader(((resourcecall_t*) arg)->shader); }
+static void call_create_render_target(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->target = _create_render_target(call->width, call->height); }
+static void call_free_render_target(void* arg) { _free_render_target(((resourcecall_t*) arg)->target); }
+static void call_create_mesh(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->mesh = _create_mesh(call->vertices, call->width, call->indices, call->height); }
+static void call_free_mesh(void* arg) { _free_mesh(((resourcecall_t*) arg)->mesh); }
+static void call_create_particles(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->particles = _create_particles(call->width, call->particle_params); }
+static void call_free_particles(void* arg) { _free_particles(((resourcecall_t*) arg)->particles); }
+static void call_load_texture_memory(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->texture = _load_texture_memory(call->buffer, call->width, call->adopt); }
+static void call_load_font_memory(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->font = _load_font_memory(call->buffer, call->width, call->adopt); }
+static void call_create_texture(void* arg) { resourcecall_t* call = (resourcecall_t*) arg; call->texture = _create_texture(call->width, call->height, call->format); }
+static void call_free_tilemap(void* arg) { _free_tilemap(((resourcecall_t*) arg)->tilemap); }
+
+//commands recorded earlier in the frame still hold the resource, and the frame before it
+//may still be drawing, so frees run on the render thread once their frame is done
+typedef struct
+{
+	render_func func;
+	resourcecall_t call;
+} deferredfree_t;
+
+static deferredfree_t* g_frees[2] = {NULL, NULL};
+static int g_num_frees[2] = {0, 0};
+static int g_max_frees[2] = {0, 0};
+
+static void defer_free(render_func func, const resourcecall_t* call)
+{
+	int frame = g_recording;
+	deferredfree_t* entry;
+
+	if ( g_num_frees[frame] == g_max_frees[frame] )
+	{
+		g_max_frees[frame] = g_max_frees[frame] ? g_max_frees[frame] * 2 : 64;
+		g_frees[frame] = (deferredfree_t*) mem_realloc(g_frees[frame], sizeof(deferredfree_t) * g_max_frees[frame], MEMORY_GENERAL);
+	}
+
+	entry = &g_frees[frame][g_num_frees[frame]++];
+	entry->func = func;
+	entry->call = *call;
+}
+
+static void run_frees(int frame)
+{
+	int i;
+	for (i=0; i<g_num_frees[frame]; ++i)
+	{
+		g_frees[frame][i].func(&g_frees[frame][i].call);
+	}
+	g_num_frees[frame] = 0;
+}
+
+static texture_t _rt_load_texture(const char* filename)
+{
+	resourcecall_t call = {0};
+	call.filename = filename;
+	render_call(call_load_texture, &call);
+	return call.texture;
+}
+
+static font_t _rt_load_font(const char* filename)
+{
+	resourcecall_t call = {0};
+	call.filename = filename;
+	render_call(call_load_font, &call);
+	return call.font;
+}
+
+static font_t _rt_load_font_ex(const char* filename, int pixel_size, const fontoptions_t* options)
+{
+	resourcecall_t call = {0};
+	call.filename = filename;
+	call.width = pixel_size;
+	call.font_options = options;
+	render_call(call_load_font_ex, &call);
+	return call.font;
+}
+
+static void _rt_free_texture(texture_t texture)
+{
+	resourcecall_t call = {0};
+	call.texture = texture;
+	defer_free(call_free_texture, &call);
+}
+
+static texture_t _rt_load_texture_memory(const void* buffer, int size, bool adopt)
+{
+	resourcecall_t call = {0};
+	call.buffer = buffer;
+	call.width = size;
+	call.adopt = adopt;
+	render_call(call_load_texture_memory, &call);
+	return call.texture;
+}
+
+static font_t _rt_load_font_memory(const void* buffer, int size, bool adopt)
+{
+	resourcecall_t call = {0};
+	call.buffer = buffer;
+	call.width = size;
+	call.adopt = adopt;
+	render_call(call_load_font_memory, &call);
+	return call.font;
+}
+
+static texture_t _rt_create_texture(int width, int height, textureformat_t format)
+{
+	resourcecall_t call = {0};
+	call.width = width;
+	call.height = height;
+	call.format = format;
+	render_call(call_create_texture, &call);
+	return call.texture;
+}
+
+//the pixels are copied into the frame so the caller can reuse them right away
+static void _rt_update_texture(texture_t texture, int x, int y, int width, int height, const void* pixels)
+{
+	_drawlist_update_texture(g_frames[g_recording], texture, x, y, width, height, pixels);
+}
+
+static void _rt_free_font(font_t font)
+{
+	resourcecall_t call = {0};
+	call.font = font;
+	defer_free(call_free_font, &call);
+}
+
+static shader_t _rt_load_shader(const char* vertex_filename, const char* fragment_filename)
+{
+	resourcecall_t call = {0};
+	call.filename = vertex_filename;
+	call.filename2 = fragment_filename;
+	render_call(call_load_shader, &call);
+	return call.shader;
+}
+
+static shader_t _rt_create_shader(const char* vertex_source, const char* fragment_source)
+{
+	resourcecall_t call = {0};
+	call.filename = vertex_source;
+	call.filename2 = fragment_source;
+	render_call(call_create_shader, &call);
+	return call.shader;
+}
+
+static void _rt_free_shader(shader_t shader)
+{
+	resourcecall_t call = {0};
+	call.shader = shader;
+	defer_free(call_free_shader, &call);
+}
+
+static rendertarget_t _rt_create_render_target(int width, int height)
+{
+	resourcecall_t call = {0};
+	call.width = width;
+	call.height = height;
+	render_call(call_create_render_target, &call);
+	return call.target;
+}
+
+static void _rt_free_render_target(rendertarget_t target)
+{
+	resourcecall_t call = {0};
+	call.target = target;
+	defer_free(call_free_render_target, &call);
+}
+
+static mesh_t _rt_create_mesh(const colorvertex_t* vertices, int num_vertices, const unsigned int* indices, int num_indices)
+{
+	resourcecall_t call = {0};
+	call.vertices = vertices;
+	call.width = num_vertices;
+	call.indices = indices;
+	call.height = num_indices;
+	render_call(call_create_mesh, &call);
+	return call.mesh;
+}
+
+static void _rt_free_mesh(mesh_t mesh)
+{
+	resourcecall_t call = {0};
+	call.mesh = mesh;
+	defer_free(call_free_mesh, &call);
+}
+
+static void _rt_draw_mesh(mesh_t mesh, const transform_t* transform) { _drawlist_mesh(g_frames[g_recording], mesh, transform); }
+
+static particles_t _rt_create_particles(int max_particles, const particleparams_t* params)
+{
+	resourcecall_t call = {0};
+	call.width = max_particles;
+	call.particle_params = params;
+	render_call(call_create_particles, &call);
+	return call.particles;
+}
+
+static void _rt_free_particles(particles_t particles)
+{
+	resourcecall_t call = {0};
+	call.particles = particles;
+	defer_free(call_free_particles, &call);
+}
+
+//the instances are filled on this thread into a copy per frame in flight
+static void _rt_draw_particles(particles_t particles)
+{
+	int count;
+	const particleinstance_t* instances = stage_particles(particles, g_recording, &count);
+	if ( count ) _drawlist_particles(g_frames[g_recording], particles, instances, count);
+}
+
+static void _rt_free_tilemap(tilemap_t tilemap)
+{
+	resourcecall_t call = {0};
+	call.tilemap = tilemap;
+	defer_free(call_free_tilemap, &call);
+}
+
+static void _rt_draw_tilemap(tilemap_t tilemap, float x, float y) { _drawlist_tilemap(g_frames[g_recording], tilemap, x, y); }
+
+static void _rt_set_camera(const camera_t* camera) { _drawlist_set_camera(g_frames[g_recording], camera); }
+static void _rt_push_transform(const transform_t* transform) { _drawlist_push_transform(g_frames[g_recording], transform); }
+static void _rt_pop_transform(void) { _drawlist_pop_transform(g_frames[g_recording]); }
+
+static void _rt_set_render_target(rendertarget_t target) { _drawlist_set_render_target(g_frames[g_recording], target); }
+static void _rt_clear(color_t color) { _drawlist_clear(g_frames[g_recording], color); }
+
+static void _rt_set_shader(shader_t shader) { _drawlist_set_shader(g_frames[g_recording], shader); }
+static void _rt_set_uniform_int(const char* name, int x) { _drawlist_set_uniform_int(g_frames[g_recording], name, x); }
+static void _rt_set_uniform_float(const char* name, float x) { _drawlist_set_uniform_float(g_frames[g_recording], name, x); }
+static void _rt_set_uniform_vec2(const char* name, float x, float y) { _drawlist_set_uniform_vec2(g_frames[g_recording], name, x, y); }
+static void _rt_set_uniform_vec4(const char* name, float x, float y, float z, float w) { _drawlist_set_uniform_vec4(g_frames[g_recording], name, x, y, z, w); }
+
+static void _rt_set_blend(blend_t blend) { _drawlist_set_blend(g_frames[g_recording], blend); }
+static void _rt_set_texture(texture_t texture) { _drawlist_set_texture(g_frames[g_recording], texture); }
+static void _rt_set_color(color_t color) { _drawlist_set_color(g_frames[g_recording], color); }
+
+static void _rt_draw_rect(float x, float y, float width, float height)
+{
+	_drawlist_rect(g_frames[g_recording], x, y, width, height);
+}
+
+static void _rt_draw_sprite(float x, float y, float width, float height, float rotation)
+{
+	_drawlist_sprite(g_frames[g_recording], x, y, width, height, rotation);
+}
+
+static void _rt_draw_quad(vertex_t vertices[4])
+{
+	_drawlist_quad(g_frames[g_recording], vertices);
+}
+
+static void _rt_draw_polygon(vertex_t* vertices, int num_vertices)
+{
+	_drawlist_polygon(g_frames[g_recording], vertices, num_vertices);
+}
+
+static void _rt_draw_quad_colored(colorvertex_t vertices[4])
+{
+	_drawlist_quad_colored(g_frames[g_recording], vertices);
+}
+
+static void _rt_draw_polygon_colored(colorvertex_t* vertices, int num_vertices)
+{
+	_drawlist_polygon_colored(g_frames[g_recording], vertices, num_vertices);
+}
+
+static void _rt_draw_text(font_t font, float x, float y, const char* text)
+{
+	_drawlist_text(g_frames[g_recording], font, x, y, text);
+}
+
+//user lists may be reset as soon as this returns, so copy them into the frame
+static void _rt_submit_drawlists(drawlist_t* lists, int num_lists)
+{
+	int i;
+	for (i=0; i<num_lists; ++i)
+	{
+		if ( lists[i] ) _drawlist_append(g_frames[g_recording], lists[i]);
+	}
+}
+
+bool render_thread_active()
+{
+	return g_thread != NULL;
+}
+
+void render_thread_submit()
+{
+	//wait for the previous frame, its list becomes the next one to record into
+	semaphore_wait(g_frame_done, -1);
+
+	g_recording ^= 1;
+	_drawlist_reset(g_frames[g_recording]);
+
+	atomic_set(&g_frame_pending, 1);
+	semaphore_post(g_wake, 1);
+}
+
+void render_thread_resize(int width, int height)
+{
+	atomic_set(&g_width, width);
+	atomic_set(&g_height, height);
+	atomic_set(&g_resize_pending, 1);
+}
+
+bool init_render_thread(libgfx_t* gfx, struct GLFWwindow* window)
+{
+	g_window = window;
+	g_frames[0] = _create_drawlist();
+	g_frames[1] = _create_drawlist();
+	g_recording = 0;
+
+	g_wake = semaphore_create();
+	g_frame_done = semaphore_create();
+	g_call_done = semaphore_create();
+	g_call_lock = mutex_create();
+
+	//no frame in flight yet
+	semaphore_post(g_frame_done, 1);
+
+	atomic_set(&g_running, 1);
+	glfwMakeContextCurrent(NULL);
+
+	g_thread = thread_create(render_main, NULL);
+	if ( g_thread == NULL )
+	{
+		glfwMakeContextCurrent(window);
+		return false;
+	}
+
+	gfx->load_texture = _rt_load_texture;
+	gfx->load_font = _rt_load_font;
+	gfx->load_font_ex = _rt_load_font_ex;
+	gfx->free_texture = _rt_free_texture;
+	gfx->free_font = _rt_free_font;
+	gfx->load_texture_memory = _rt_load_texture_memory;
+	gfx->load_font_memory = _rt_load_font_memory;
+	gfx->create_texture = _rt_create_texture;
+	gfx->update_texture = _rt_update_texture;
+
+	gfx->set_blend = _rt_set_blend;
+	gfx->set_texture = _rt_set_texture;
+	gfx->set_color = _rt_set_color;
+
+	gfx->draw_rect = _rt_draw_rect;
+	gfx->draw_sprite = _rt_draw_sprite;
+	gfx->draw_quad = _rt_draw_quad;
+	gfx->draw_polygon = _rt_draw_polygon;
+	gfx->draw_text = _rt_draw_text;
+	gfx->draw_quad_colored = _rt_draw_quad_colored;
+	gfx->draw_polygon_colored = _rt_draw_polygon_colored;
+	gfx->submit_drawlists = _rt_submit_drawlists;
+
+	gfx->load_shader = _rt_load_shader;
+	gfx->create_shader = _rt_create_shader;
+	gfx->free_shader = _rt_free_shader;
+	gfx->set_shader = _rt_set_shader;
+	gfx->set_uniform_int = _rt_set_uniform_int;
+	gfx->set_uniform_float = _rt_set_uniform_float;
+	gfx->set_uniform_vec2 = _rt_set_uniform_vec2;
+	gfx->set_uniform_vec4 = _rt_set_uniform_vec4;
+
+	gfx->create_render_target = _rt_create_render_target;
+	gfx->free_render_target = _rt_free_render_target;
+	gfx->set_render_target = _rt_set_render_target;
+	gfx->clear = _rt_clear;
+
+	gfx->create_mesh = _rt_create_mesh;
+	gfx->free_mesh = _rt_free_mesh;
+	gfx->draw_mesh = _rt_draw_mesh;
+
+	gfx->set_camera = _rt_set_camera;
+	gfx->push_transform = _rt_push_transform;
+	gfx->pop_transform = _rt_pop_transform;
+
+	gfx->create_particles = _rt_create_particles;
+	gfx->free_particles = _rt_free_particles;
+	gfx->draw_particles = _rt_draw_particles;
+
+	//tiles are edited on the game thread and the chunk meshes rebuilt on the render thread,
+	//the tilemap's lock covers the overlap
+	gfx->free_tilemap = _rt_free_tilemap;
+	gfx->draw_tilemap = _rt_draw_tilemap;
+
+	return true;
+}
+
+void shutdown_render_thread()
+{
+	if ( g_thread == NULL ) return;
+
+	//let the last frame finish, then take the context back for cleanup
+	semaphore_wait(g_frame_done, -1);
+	atomic_set(&g_running, 0);
+	semaphore_post(g_wake, 1);
+	thread_join(g_thread);
+	g_thread = NULL;
+
+	glfwMakeContextCurrent(g_window);
+
+	//both frames are drawn or were never submitted
+	run_frees(g_recording ^ 1);
+	run_frees(g_recording);
+	mem_free(g_frees[0]);
+	mem_free(g_frees[1]);
+	g_frees[0] = g_frees[1] = NULL;
+	g_max_frees[0] = g_max_frees[1] = 0;
+
+	_free_drawlist(g_frames[0]);
+	_free_drawlist(g_frames[1]);
+	semaphore_free(g_wake);
+	semaphore_free(g_frame_done);
+	semaphore_free(g_call_done);
+	mutex_free(g_call_lock);
+}
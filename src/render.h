@@ -0,0 +1,9 @@
+#include "lib.h"
+
+struct GLFWwindow;
+
+extern bool init_render_thread(libgfx_t* gfx, struct GLFWwindow* window);
+extern void shutdown_render_thread();
+extern bool render_thread_active();
+extern void render_thread_submit();
+extern void render_thread_resize(int width, int height);
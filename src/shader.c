@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "glstate.h"
+#include "memory.h"
+#include "shader.h"
+
+static const char* g_vertex_source =
+	"#version 330 core\n"
+	"layout(location = 0) in vec2 a_position;\n"
+	"layout(location = 1) in vec2 a_texcoord;\n"
+	"layout(location = 2) in vec4 a_color;\n"
+	"uniform mat4 u_projection;\n"
+	"uniform mat4 u_model;\n"
+	"out vec2 v_texcoord;\n"
+	"out vec4 v_color;\n"
+	"void main()\n"
+	"{\n"
+	"	v_texcoord = a_texcoord;\n"
+	"	v_color = a_color;\n"
+	"	gl_Position = u_projection * (u_model * vec4(a_position, 0.0, 1.0));\n"
+	"}\n";
+
+//one quad per instance, the corners come from gl_VertexID drawn as a 4 vertex strip
+static const char* g_particle_vertex_source =
+	"#version 330 core\n"
+	"layout(location = 0) in vec3 a_instance;\n"
+	"layout(location = 1) in vec4 a_color;\n"
+	"uniform mat4 u_projection;\n"
+	"uniform mat4 u_model;\n"
+	"out vec2 v_texcoord;\n"
+	"out vec4 v_color;\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1);\n"
+	"	v_texcoord = corner;\n"
+	"	v_color = a_color;\n"
+	"	gl_Position = u_projection * (u_model * vec4(a_instance.xy + (corner - 0.5) * a_instance.z, 0.0, 1.0));\n"
+	"}\n";
+
+//the particle programs reuse the textured and untextured fragment shaders
+static const char* g_fragment_sources[PROGRAM_PARTICLE] =
+{
+	//PROGRAM_TEXTURED
+	"#version 330 core\n"
+	"uniform sampler2D u_texture;\n"
+	"in vec2 v_texcoord;\n"
+	"in vec4 v_color;\n"
+	"out vec4 o_color;\n"
+	"void main() { o_color = texture(u_texture, v_texcoord) * v_color; }\n",
+
+	//PROGRAM_UNTEXTURED
+	"#version 330 core\n"
+	"in vec4 v_color;\n"
+	"out vec4 o_color;\n"
+	"void main() { o_color = v_color; }\n",
+
+	//PROGRAM_ALPHA, single channel font atlases
+	"#version 330 core\n"
+	"uniform sampler2D u_texture;\n"
+	"in vec2 v_texcoord;\n"
+	"in vec4 v_color;\n"
+	"out vec4 o_color;\n"
+	"void main() { o_color = vec4(v_color.rgb, v_color.a * texture(u_texture, v_texcoord).r); }\n",
+};
+
+static GLuint compile_shader(GLenum type, const char* source)
+{
+	GLuint shader = glCreateShader(type);
+	GLint status;
+
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+	if ( !status )
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("SHADER ERROR %s\n", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	return shader;
+}
+
+unsigned int compile_program(const char* vertex_source, const char* fragment_source)
+{
+	GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_source);
+	GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+	GLuint program;
+	GLint status;
+
+	if ( !vs || !fs )
+	{
+		glDeleteShader(vs);
+		glDeleteShader(fs);
+		return 0;
+	}
+
+	program = glCreateProgram();
+	glAttachShader(program, vs);
+	glAttachShader(program, fs);
+	glLinkProgram(program);
+	glDeleteShader(vs);
+	glDeleteShader(fs);
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	if ( !status )
+	{
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		printf("PROGRAM ERROR %s\n", log);
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+static void init_program(program_t* p)
+{
+	p->u_projection = glGetUniformLocation(p->program, "u_projection");
+	p->u_model = glGetUniformLocation(p->program, "u_model");
+	p->projection_serial = -1;
+	p->model_serial = -1;
+}
+
+bool init_builtin_programs(program_t* programs)
+{
+	int i;
+	for (i=0; i<PROGRAM_COUNT; ++i)
+	{
+		program_t* p = &programs[i];
+		if ( i == PROGRAM_PARTICLE ) p->program = compile_program(g_particle_vertex_source, g_fragment_sources[PROGRAM_TEXTURED]);
+		else if ( i == PROGRAM_PARTICLE_UNTEXTURED ) p->program = compile_program(g_particle_vertex_source, g_fragment_sources[PROGRAM_UNTEXTURED]);
+		else p->program = compile_program(g_vertex_source, g_fragment_sources[i]);
+		if ( !p->program ) return false;
+
+		init_program(p);
+
+		gl_use_program(p->program);
+		glUniform1i(glGetUniformLocation(p->program, "u_texture"), 0);
+	}
+	gl_use_program(0);
+	return true;
+}
+
+void free_builtin_programs(program_t* programs)
+{
+	int i;
+	for (i=0; i<PROGRAM_COUNT; ++i)
+	{
+		gl_delete_program(programs[i].program);
+		programs[i].program = 0;
+	}
+}
+
+shaderdata_t* create_user_shader(const char* vertex_source, const char* fragment_source)
+{
+	shaderdata_t* shader;
+	GLuint program = compile_program(vertex_source ? vertex_source : g_vertex_source, fragment_source);
+	if ( !program ) return NULL;
+
+	shader = (shaderdata_t*) mem_alloc(sizeof(shaderdata_t), MEMORY_SHADER);
+	memset(shader, 0, sizeof(shaderdata_t));
+	shader->base.program = program;
+	init_program(&shader->base);
+
+	shader->max_slots = 16;
+	shader->slots = (uniformslot_t*) mem_calloc(shader->max_slots, sizeof(uniformslot_t), MEMORY_SHADER);
+
+	return shader;
+}
+
+void free_user_shader(shaderdata_t* shader)
+{
+	int i;
+	if ( shader == NULL ) return;
+
+	for (i=0; i<shader->max_slots; ++i) mem_free(shader->slots[i].name);
+	mem_free(shader->slots);
+	gl_delete_program(shader->base.program);
+	mem_free(shader);
+}
+
+static unsigned int hash_name(const char* name)
+{
+	unsigned int hash = 2166136261u;
+	while ( *name )
+	{
+		hash ^= (unsigned char) *name++;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static uniformslot_t* probe(uniformslot_t* slots, int max_slots, unsigned int hash, const char* name)
+{
+	unsigned int i = hash & (max_slots - 1);
+	while ( slots[i].name && (slots[i].hash != hash || strcmp(slots[i].name, name) != 0) )
+	{
+		i = (i + 1) & (max_slots - 1);
+	}
+	return &slots[i];
+}
+
+uniformslot_t* find_uniform(shaderdata_t* shader, const char* name)
+{
+	unsigned int hash = hash_name(name);
+	uniformslot_t* slot = probe(shader->slots, shader->max_slots, hash, name);
+	size_t length;
+
+	if ( slot->name ) return slot;
+
+	//keep the table at most half full
+	if ( (shader->num_slots + 1) * 2 > shader->max_slots )
+	{
+		int max_slots = shader->max_slots * 2;
+		uniformslot_t* slots = (uniformslot_t*) mem_calloc(max_slots, sizeof(uniformslot_t), MEMORY_SHADER);
+		int i;
+
+		for (i=0; i<shader->max_slots; ++i)
+		{
+			uniformslot_t* old = &shader->slots[i];
+			if ( old->name ) *probe(slots, max_slots, old->hash, old->name) = *old;
+		}
+
+		mem_free(shader->slots);
+		shader->slots = slots;
+		shader->max_slots = max_slots;
+		slot = probe(slots, max_slots, hash, name);
+	}
+
+	length = strlen(name) + 1;
+	slot->name = (char*) mem_alloc(length, MEMORY_SHADER);
+	memcpy(slot->name, name, length);
+	slot->hash = hash;
+	slot->location = glGetUniformLocation(shader->base.program, name);
+	slot->set = false;
+	shader->num_slots++;
+
+	return slot;
+}
@@ -0,0 +1,65 @@
+#ifndef GAMELIB_SHADER_H
+#define GAMELIB_SHADER_H
+
+#include "lib.h"
+
+typedef enum
+{
+	PROGRAM_TEXTURED,
+	PROGRAM_UNTEXTURED,
+	PROGRAM_ALPHA,
+	PROGRAM_PARTICLE,
+	PROGRAM_PARTICLE_UNTEXTURED,
+	PROGRAM_COUNT,
+} programtype_t;
+
+typedef struct
+{
+	unsigned int program;
+	int u_projection;
+	int u_model;
+	int projection_serial; //which projection was last uploaded
+	int model_serial; //which model transform was last uploaded
+} program_t;
+
+extern bool init_builtin_programs(program_t* programs);
+extern void free_builtin_programs(program_t* programs);
+extern unsigned int compile_program(const char* vertex_source, const char* fragment_source);
+
+typedef enum
+{
+	UNIFORM_INT,
+	UNIFORM_FLOAT,
+	UNIFORM_VEC2,
+	UNIFORM_VEC4,
+} uniformtype_t;
+
+typedef struct
+{
+	uniformtype_t type;
+	union { float f[4]; int i; } data;
+} uniformvalue_t;
+
+//one cached uniform, location is resolved on first use and -1 if the program doesn't have it
+typedef struct
+{
+	char* name;
+	unsigned int hash;
+	int location;
+	bool set; //value holds what was last uploaded
+	uniformvalue_t value;
+} uniformslot_t;
+
+typedef struct
+{
+	program_t base;
+	uniformslot_t* slots; //open addressed, power of two size
+	int num_slots;
+	int max_slots;
+} shaderdata_t;
+
+extern shaderdata_t* create_user_shader(const char* vertex_source, const char* fragment_source);
+extern void free_user_shader(shaderdata_t* shader);
+extern uniformslot_t* find_uniform(shaderdata_t* shader, const char* name);
+
+#endif //GAMELIB_SHADER_H
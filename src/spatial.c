@@ -0,0 +1,312 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "memory.h"
+#include "spatial.h"
+
+//hashed uniform grid. objects are kept in flat arrays and the cell index is rebuilt with a
+//counting sort by bucket the first time it's queried after a change, so a frame of moving
+//objects costs one rebuild however many updates came before it
+
+typedef struct
+{
+	int id;
+	int cx;
+	int cy;
+} cellentry_t;
+
+typedef struct
+{
+	float cell_size;
+	float inv_cell_size;
+
+	//objects by id, bounds is x0, y0, x1, y1
+	float* bounds;
+	bool* alive;
+	int* free_ids;
+	int num_free;
+	int num_ids;
+	int max_ids;
+
+	//bucket b holds entries[starts[b]] .. entries[starts[b+1]-1]
+	int* starts;
+	int num_buckets;
+	cellentry_t* entries;
+	int max_entries;
+	int min_cell[2];
+	int max_cell[2];
+	bool dirty;
+} griddata_t;
+
+static unsigned int hash_cell(int cx, int cy)
+{
+	return ((unsigned int) cx * 73856093u) ^ ((unsigned int) cy * 19349663u);
+}
+
+static int to_cell(const griddata_t* grid, float v)
+{
+	return (int) floorf(v * grid->inv_cell_size);
+}
+
+static bool overlaps(const float* a, const float* b)
+{
+	return a[0] <= b[2] && b[0] <= a[2] && a[1] <= b[3] && b[1] <= a[3];
+}
+
+spatialgrid_t _create_spatial_grid(float cell_size)
+{
+	griddata_t* grid;
+	if ( cell_size <= 0.f ) return NULL;
+
+	grid = (griddata_t*) mem_alloc(sizeof(griddata_t), MEMORY_SPATIAL);
+	memset(grid, 0, sizeof(griddata_t));
+	grid->cell_size = cell_size;
+	grid->inv_cell_size = 1.f / cell_size;
+	grid->max_cell[0] = grid->max_cell[1] = -1; //empty, same as an empty rebuild
+	return grid;
+}
+
+void _free_spatial_grid(spatialgrid_t handle)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	if ( grid == NULL ) return;
+
+	mem_free(grid->bounds);
+	mem_free(grid->alive);
+	mem_free(grid->free_ids);
+	mem_free(grid->starts);
+	mem_free(grid->entries);
+	mem_free(grid);
+}
+
+//negative sizes are clamped, rebuild relies on x0 <= x1 and y0 <= y1 to size its arrays
+static void set_bounds(griddata_t* grid, int id, float x, float y, float width, float height)
+{
+	grid->bounds[id*4+0] = x;
+	grid->bounds[id*4+1] = y;
+	grid->bounds[id*4+2] = x + (width > 0.f ? width : 0.f);
+	grid->bounds[id*4+3] = y + (height > 0.f ? height : 0.f);
+	grid->dirty = true;
+}
+
+int _spatial_insert(spatialgrid_t handle, float x, float y, float width, float height)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	int id;
+
+	if ( grid->num_free > 0 )
+	{
+		id = grid->free_ids[--grid->num_free];
+	}
+	else
+	{
+		if ( grid->num_ids == grid->max_ids )
+		{
+			grid->max_ids = grid->max_ids ? grid->max_ids * 2 : 256;
+			grid->bounds = (float*) mem_realloc(grid->bounds, sizeof(float) * 4 * grid->max_ids, MEMORY_SPATIAL);
+			grid->alive = (bool*) mem_realloc(grid->alive, sizeof(bool) * grid->max_ids, MEMORY_SPATIAL);
+			grid->free_ids = (int*) mem_realloc(grid->free_ids, sizeof(int) * grid->max_ids, MEMORY_SPATIAL);
+		}
+		id = grid->num_ids++;
+	}
+
+	grid->alive[id] = true;
+	set_bounds(grid, id, x, y, width, height);
+	return id;
+}
+
+void _spatial_update(spatialgrid_t handle, int id, float x, float y, float width, float height)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	if ( id < 0 || id >= grid->num_ids || !grid->alive[id] ) return;
+
+	set_bounds(grid, id, x, y, width, height);
+}
+
+void _spatial_remove(spatialgrid_t handle, int id)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	if ( id < 0 || id >= grid->num_ids || !grid->alive[id] ) return;
+
+	grid->alive[id] = false;
+	grid->free_ids[grid->num_free++] = id;
+	grid->dirty = true;
+}
+
+static void rebuild(griddata_t* grid)
+{
+	int num_entries = 0;
+	int* cursor;
+	int i, cx, cy;
+
+	grid->dirty = false;
+	grid->min_cell[0] = grid->min_cell[1] = 0;
+	grid->max_cell[0] = grid->max_cell[1] = -1;
+
+	//first pass sizes everything and finds the occupied cell range
+	for (i=0; i<grid->num_ids; ++i)
+	{
+		const float* b = grid->bounds + i*4;
+		int x0, y0, x1, y1;
+		if ( !grid->alive[i] ) continue;
+
+		x0 = to_cell(grid, b[0]); y0 = to_cell(grid, b[1]);
+		x1 = to_cell(grid, b[2]); y1 = to_cell(grid, b[3]);
+		num_entries += (x1 - x0 + 1) * (y1 - y0 + 1);
+
+		if ( grid->max_cell[0] < grid->min_cell[0] )
+		{
+			grid->min_cell[0] = x0; grid->min_cell[1] = y0;
+			grid->max_cell[0] = x1; grid->max_cell[1] = y1;
+		}
+		if ( x0 < grid->min_cell[0] ) grid->min_cell[0] = x0;
+		if ( y0 < grid->min_cell[1] ) grid->min_cell[1] = y0;
+		if ( x1 > grid->max_cell[0] ) grid->max_cell[0] = x1;
+		if ( y1 > grid->max_cell[1] ) grid->max_cell[1] = y1;
+	}
+
+	if ( num_entries > grid->max_entries )
+	{
+		grid->max_entries = num_entries;
+		grid->entries = (cellentry_t*) mem_realloc(grid->entries, sizeof(cellentry_t) * grid->max_entries, MEMORY_SPATIAL);
+	}
+
+	i = 64;
+	while ( i < num_entries ) i *= 2;
+	if ( i != grid->num_buckets )
+	{
+		grid->num_buckets = i;
+		grid->starts = (int*) mem_realloc(grid->starts, sizeof(int) * (grid->num_buckets + 1), MEMORY_SPATIAL);
+	}
+	memset(grid->starts, 0, sizeof(int) * (grid->num_buckets + 1));
+
+	//count per bucket, prefix sum, then scatter
+	for (i=0; i<grid->num_ids; ++i)
+	{
+		const float* b = grid->bounds + i*4;
+		if ( !grid->alive[i] ) continue;
+
+		for (cy=to_cell(grid, b[1]); cy<=to_cell(grid, b[3]); ++cy)
+		{
+			for (cx=to_cell(grid, b[0]); cx<=to_cell(grid, b[2]); ++cx)
+			{
+				grid->starts[(hash_cell(cx, cy) & (grid->num_buckets - 1)) + 1]++;
+			}
+		}
+	}
+
+	for (i=0; i<grid->num_buckets; ++i) grid->starts[i+1] += grid->starts[i];
+
+	cursor = (int*) temp_alloc(sizeof(int) * grid->num_buckets);
+	memcpy(cursor, grid->starts, sizeof(int) * grid->num_buckets);
+
+	for (i=0; i<grid->num_ids; ++i)
+	{
+		const float* b = grid->bounds + i*4;
+		if ( !grid->alive[i] ) continue;
+
+		for (cy=to_cell(grid, b[1]); cy<=to_cell(grid, b[3]); ++cy)
+		{
+			for (cx=to_cell(grid, b[0]); cx<=to_cell(grid, b[2]); ++cx)
+			{
+				cellentry_t* entry = &grid->entries[cursor[hash_cell(cx, cy) & (grid->num_buckets - 1)]++];
+				entry->id = i;
+				entry->cx = cx;
+				entry->cy = cy;
+			}
+		}
+	}
+
+	temp_free(cursor);
+}
+
+//objects spanning several cells are only reported from the first cell they share with the
+//query, which keeps results unique without any per-query bookkeeping
+int _spatial_query(spatialgrid_t handle, float x, float y, float width, float height, int* results, int max_results)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	float query[4] = { x, y, x + width, y + height };
+	int x0, y0, x1, y1, cx, cy, i;
+	int found = 0;
+
+	if ( grid->dirty ) rebuild(grid);
+	if ( grid->num_buckets == 0 ) return 0;
+
+	x0 = to_cell(grid, query[0]); y0 = to_cell(grid, query[1]);
+	x1 = to_cell(grid, query[2]); y1 = to_cell(grid, query[3]);
+	if ( x0 < grid->min_cell[0] ) x0 = grid->min_cell[0];
+	if ( y0 < grid->min_cell[1] ) y0 = grid->min_cell[1];
+	if ( x1 > grid->max_cell[0] ) x1 = grid->max_cell[0];
+	if ( y1 > grid->max_cell[1] ) y1 = grid->max_cell[1];
+
+	for (cy=y0; cy<=y1; ++cy)
+	{
+		for (cx=x0; cx<=x1; ++cx)
+		{
+			unsigned int bucket = hash_cell(cx, cy) & (grid->num_buckets - 1);
+			for (i=grid->starts[bucket]; i<grid->starts[bucket+1]; ++i)
+			{
+				const cellentry_t* entry = &grid->entries[i];
+				const float* b = grid->bounds + entry->id*4;
+
+				if ( entry->cx != cx || entry->cy != cy ) continue;
+				if ( !overlaps(b, query) ) continue;
+				if ( to_cell(grid, fmaxf(b[0], query[0])) != cx || to_cell(grid, fmaxf(b[1], query[1])) != cy ) continue;
+
+				if ( found < max_results ) results[found] = entry->id;
+				++found;
+			}
+		}
+	}
+
+	return found;
+}
+
+int _spatial_pairs(spatialgrid_t handle, spatialpair_t* pairs, int max_pairs)
+{
+	griddata_t* grid = (griddata_t*) handle;
+	int bucket, i, j;
+	int found = 0;
+
+	if ( grid->dirty ) rebuild(grid);
+
+	for (bucket=0; bucket<grid->num_buckets; ++bucket)
+	{
+		int end = grid->starts[bucket+1];
+		for (i=grid->starts[bucket]; i<end; ++i)
+		{
+			const cellentry_t* a = &grid->entries[i];
+			const float* ba = grid->bounds + a->id*4;
+
+			for (j=i+1; j<end; ++j)
+			{
+				const cellentry_t* b = &grid->entries[j];
+				const float* bb = grid->bounds + b->id*4;
+
+				if ( a->cx != b->cx || a->cy != b->cy ) continue;
+				if ( !overlaps(ba, bb) ) continue;
+				if ( to_cell(grid, fmaxf(ba[0], bb[0])) != a->cx || to_cell(grid, fmaxf(ba[1], bb[1])) != a->cy ) continue;
+
+				if ( found < max_pairs )
+				{
+					pairs[found].a = a->id < b->id ? a->id : b->id;
+					pairs[found].b = a->id < b->id ? b->id : a->id;
+				}
+				++found;
+			}
+		}
+	}
+
+	return found;
+}
+
+void init_spatial_lib(libutil_t* util)
+{
+	util->create_spatial_grid = _create_spatial_grid;
+	util->free_spatial_grid = _free_spatial_grid;
+	util->spatial_insert = _spatial_insert;
+	util->spatial_update = _spatial_update;
+	util->spatial_remove = _spatial_remove;
+	util->spatial_query = _spatial_query;
+	util->spatial_pairs = _spatial_pairs;
+}
@@ -0,0 +1,3 @@
+#include "lib.h"
+
+extern void init_spatial_lib(libutil_t* util);
@@ -0,0 +1,46 @@
+#include <string.h>
+#include "glstate.h"
+#include "stats.h"
+#include "thread.h"
+
+renderstats_t g_frame_stats;
+static renderstats_t g_last_stats;
+static mutex_t g_stats_lock = NULL;
+
+void init_stats(void)
+{
+	memset(&g_frame_stats, 0, sizeof(renderstats_t));
+	memset(&g_last_stats, 0, sizeof(renderstats_t));
+	g_stats_lock = mutex_create();
+}
+
+void shutdown_stats(void)
+{
+	mutex_free(g_stats_lock);
+	g_stats_lock = NULL;
+}
+
+void end_stats_frame(void)
+{
+	int i;
+
+	g_frame_stats.batches = 0;
+	for (i=0; i<FLUSH_REASON_COUNT; ++i) g_frame_stats.batches += g_frame_stats.flushes[i];
+	_get_state_calls(&g_frame_stats.state_calls, &g_frame_stats.state_calls_filtered);
+
+	//the game thread may be reading while the render thread finishes a frame
+	mutex_lock(g_stats_lock);
+	g_last_stats = g_frame_stats;
+	mutex_unlock(g_stats_lock);
+
+	memset(&g_frame_stats, 0, sizeof(renderstats_t));
+}
+
+void _get_render_stats(renderstats_t* stats)
+{
+	if ( stats == NULL ) return;
+
+	mutex_lock(g_stats_lock);
+	*stats = g_last_stats;
+	mutex_unlock(g_stats_lock);
+}
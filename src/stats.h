@@ -0,0 +1,15 @@
+#ifndef GAMELIB_STATS_H
+#define GAMELIB_STATS_H
+
+#include "lib.h"
+
+//counters for the frame being drawn, bumped in place by the GL thread so they cost an add each
+extern renderstats_t g_frame_stats;
+
+extern void init_stats(void);
+extern void shutdown_stats(void);
+//publishes the frame's counters for get_render_stats and starts the next frame from zero
+extern void end_stats_frame(void);
+extern void _get_render_stats(renderstats_t* stats);
+
+#endif //GAMELIB_STATS_H
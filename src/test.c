@@ -30,6 +30,9 @@ static void resize(int width, int height) { fieldwidth = width; fieldheight = he
 //called on startup right after the library initializes, create things here
 static bool start(void)
 {
+	const inittimes_t* times = lib->util->get_init_times();
+	printf("init %.1fms (window %.1fms, gl load %.1fms, gfx %.1fms, preload %.1fms)\n", times->total, times->window, times->gl_load, times->gfx, times->preload);
+
 	my_texture = lib->gfx->load_texture("Gear.png");
 	my_font = lib->gfx->load_font("NotoMono-Regular.ttf");
 
@@ -121,6 +124,7 @@ int main(int argc, const char**argv)
 	params.cb_loop = loop;
 	params.cb_stop = stop;
 	params.cb_mousemove = mouse_moved;
+	params.coalesce_mousemove = true;
 	params.cb_keyboard = keyboard;
 	if ( !lib->init( &params ) )
 	{
@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "draw.h"
+#include "glstate.h"
+#include "job.h"
+#include "memory.h"
+#include "stats.h"
+#include "texcache.h"
+#include "thread.h"
+
+#define AVERAGE_SAMPLES 4096
+
+typedef enum
+{
+	TEXTURE_RESIDENT,
+	TEXTURE_EVICTED,
+	TEXTURE_LOADING,
+} texturestate_t;
+
+typedef struct texentry_s
+{
+	texture_t texture;
+	char* filename; //set for textures that can be evicted
+	int bytes;
+	color_t average;
+	int last_frame;
+	texturestate_t state;
+	//written by the reload job, read once job.pending drops to zero
+	void* pixels;
+	int width;
+	int height;
+	jobcounter_t job;
+	struct texentry_s* prev;
+	struct texentry_s* next;
+} texentry_t;
+
+//entries are indexed by texture name, GL hands those out densely from 1
+static texentry_t** g_entries = NULL;
+static int g_max_entries = 0;
+static texentry_t* g_head = NULL; //most recently drawn
+static texentry_t* g_tail = NULL;
+static long long g_budget = 0;
+static long long g_bytes = 0;
+static int g_frame = 0;
+static int g_num_loading = 0;
+
+static texentry_t* find_entry(texture_t texture)
+{
+	return texture < (texture_t) g_max_entries ? g_entries[texture] : NULL;
+}
+
+static void unlink_entry(texentry_t* entry)
+{
+	if ( entry->prev ) entry->prev->next = entry->next;
+	else g_head = entry->next;
+	if ( entry->next ) entry->next->prev = entry->prev;
+	else g_tail = entry->prev;
+	entry->prev = entry->next = NULL;
+}
+
+static void link_head(texentry_t* entry)
+{
+	entry->prev = NULL;
+	entry->next = g_head;
+	if ( g_head ) g_head->prev = entry;
+	g_head = entry;
+	if ( g_tail == NULL ) g_tail = entry;
+}
+
+//a handful of evenly spaced texels is plenty for a stand-in color
+static color_t average_color(const unsigned char* pixels, int count)
+{
+	unsigned int sum[4] = {0};
+	int step = count > AVERAGE_SAMPLES ? count / AVERAGE_SAMPLES : 1;
+	int samples = 0;
+	int i;
+
+	for (i=0; i<count; i+=step)
+	{
+		sum[0] += pixels[i*4+0];
+		sum[1] += pixels[i*4+1];
+		sum[2] += pixels[i*4+2];
+		sum[3] += pixels[i*4+3];
+		++samples;
+	}
+
+	if ( samples == 0 ) return 0;
+	return COLOR4(sum[0] / samples, sum[1] / samples, sum[2] / samples, sum[3] / samples);
+}
+
+void track_texture(texture_t texture, int width, int height, int bytes_per_pixel, const void* pixels)
+{
+	texentry_t* entry;
+
+	if ( texture == 0 ) return;
+
+	if ( texture >= (texture_t) g_max_entries )
+	{
+		int max_entries = g_max_entries ? g_max_entries : 256;
+		while ( max_entries <= (int) texture ) max_entries *= 2;
+		g_entries = (texentry_t**) mem_realloc(g_entries, sizeof(texentry_t*) * max_entries, MEMORY_GENERAL);
+		memset(g_entries + g_max_entries, 0, sizeof(texentry_t*) * (max_entries - g_max_entries));
+		g_max_entries = max_entries;
+	}
+
+	untrack_texture(texture);
+
+	entry = (texentry_t*) mem_calloc(1, sizeof(texentry_t), MEMORY_GENERAL);
+	entry->texture = texture;
+	entry->bytes = width * height * bytes_per_pixel;
+	entry->average = pixels && bytes_per_pixel == 4 ? average_color((const unsigned char*) pixels, width * height) : 0;
+	entry->last_frame = g_frame;
+	entry->state = TEXTURE_RESIDENT;
+
+	g_entries[texture] = entry;
+	g_bytes += entry->bytes;
+	link_head(entry);
+}
+
+static void discard_reload(texentry_t* entry)
+{
+	if ( entry->state != TEXTURE_LOADING ) return;
+
+	_job_wait(&entry->job);
+	if ( entry->pixels ) free_pixels(entry->pixels);
+	entry->pixels = NULL;
+	g_num_loading--;
+}
+
+void untrack_texture(texture_t texture)
+{
+	texentry_t* entry = find_entry(texture);
+	if ( entry == NULL ) return;
+
+	discard_reload(entry);
+	if ( entry->state == TEXTURE_RESIDENT ) g_bytes -= entry->bytes;
+
+	unlink_entry(entry);
+	g_entries[texture] = NULL;
+	mem_free(entry->filename);
+	mem_free(entry);
+}
+
+void set_texture_source(texture_t texture, const char* filename)
+{
+	texentry_t* entry = find_entry(texture);
+	size_t length;
+
+	if ( entry == NULL || filename == NULL ) return;
+
+	length = strlen(filename) + 1;
+	mem_free(entry->filename);
+	entry->filename = (char*) mem_alloc(length, MEMORY_GENERAL);
+	memcpy(entry->filename, filename, length);
+}
+
+static void reload_job(void* data)
+{
+	texentry_t* entry = (texentry_t*) data;
+	entry->pixels = decode_texture(entry->filename, &entry->width, &entry->height);
+}
+
+static void finish_reload(texentry_t* entry)
+{
+	g_num_loading--;
+
+	if ( entry->pixels == NULL )
+	{
+		//keep the placeholder rather than retrying every frame
+		printf("CAN'T RELOAD %s\n", entry->filename);
+		mem_free(entry->filename);
+		entry->filename = NULL;
+		entry->bytes = 4;
+		entry->state = TEXTURE_RESIDENT;
+		g_bytes += entry->bytes;
+		return;
+	}
+
+	fill_texture(entry->texture, entry->pixels, entry->width, entry->height);
+	entry->pixels = NULL;
+	entry->bytes = entry->width * entry->height * 4;
+	entry->state = TEXTURE_RESIDENT;
+	g_bytes += entry->bytes;
+	g_frame_stats.textures_reloaded++;
+}
+
+void touch_texture(texture_t texture)
+{
+	texentry_t* entry = find_entry(texture);
+	if ( entry == NULL || entry->last_frame == g_frame ) return;
+
+	entry->last_frame = g_frame;
+	unlink_entry(entry);
+	link_head(entry);
+
+	if ( entry->state != TEXTURE_EVICTED ) return;
+
+	entry->state = TEXTURE_LOADING;
+	g_num_loading++;
+	_job_submit(reload_job, entry, &entry->job);
+
+	//without worker threads the job ran inline and is ready for this draw, otherwise
+	//update_texture_cache uploads it once the decode is done
+	if ( atomic_get(&entry->job.pending) == 0 ) finish_reload(entry);
+}
+
+static void evict(texentry_t* entry)
+{
+	gl_bind_texture(0, entry->texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &entry->average);
+
+	g_bytes -= entry->bytes;
+	entry->state = TEXTURE_EVICTED;
+	g_frame_stats.textures_evicted++;
+}
+
+void update_texture_cache(void)
+{
+	texentry_t* entry;
+	int i;
+
+	for (i=0; i<g_max_entries && g_num_loading > 0; ++i)
+	{
+		entry = g_entries[i];
+		if ( entry && entry->state == TEXTURE_LOADING && atomic_get(&entry->job.pending) == 0 ) finish_reload(entry);
+	}
+
+	//coldest first, everything past the first texture drawn this frame is hot
+	entry = g_tail;
+	while ( g_budget > 0 && g_bytes > g_budget && entry && entry->last_frame < g_frame )
+	{
+		if ( entry->filename && entry->state == TEXTURE_RESIDENT ) evict(entry);
+		entry = entry->prev;
+	}
+
+	g_frame_stats.texture_bytes = g_bytes;
+	g_frame++;
+}
+
+void init_texture_cache(int budget_mb)
+{
+	g_budget = (long long) budget_mb * 1024 * 1024;
+	g_bytes = 0;
+	g_frame = 0;
+	g_num_loading = 0;
+}
+
+void shutdown_texture_cache(void)
+{
+	int i;
+
+	for (i=0; i<g_max_entries; ++i)
+	{
+		if ( g_entries[i] ) untrack_texture((texture_t) i);
+	}
+
+	mem_free(g_entries);
+	g_entries = NULL;
+	g_max_entries = 0;
+	g_head = g_tail = NULL;
+}
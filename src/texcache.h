@@ -0,0 +1,25 @@
+#ifndef GAMELIB_TEXCACHE_H
+#define GAMELIB_TEXCACHE_H
+
+#include "lib.h"
+
+//estimated GPU memory per texture and an LRU by the frame each was last drawn with. over
+//budget, file-backed textures that weren't drawn this frame have their storage replaced by
+//a 1x1 texel of their average color, the next draw using one reads the file back on the
+//job threads and the placeholder stands in until it's uploaded. GL thread only
+
+extern void init_texture_cache(int budget_mb);
+extern void shutdown_texture_cache(void);
+
+//pixels are only sampled for the placeholder color and may be NULL
+extern void track_texture(texture_t texture, int width, int height, int bytes_per_pixel, const void* pixels);
+extern void untrack_texture(texture_t texture);
+//makes the texture evictable, it's reloaded from filename
+extern void set_texture_source(texture_t texture, const char* filename);
+
+//called whenever a texture is about to be drawn with
+extern void touch_texture(texture_t texture);
+//finishes reloads and evicts down to the budget, once at the end of every frame
+extern void update_texture_cache(void);
+
+#endif //GAMELIB_TEXCACHE_H
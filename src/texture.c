@@ -0,0 +1,160 @@
+#include <stdlib.h>
+#include <string.h>
+#include <glad/glad.h>
+#include "draw.h"
+#include "glstate.h"
+#include "memory.h"
+#include "stats.h"
+#include "texcache.h"
+
+//updates are staged in a small ring of pixel unpack buffers. a buffer is only reused once
+//its fence says the upload out of it finished, otherwise it's orphaned so the driver hands
+//back fresh storage instead of making us wait
+#define PBO_RING 3
+
+typedef struct
+{
+	GLuint pbo;
+	int size;
+	GLsync fence;
+} pixelbuffer_t;
+
+typedef struct dyntexture_s
+{
+	texture_t texture;
+	int width;
+	int height;
+	textureformat_t format;
+	struct dyntexture_s* next;
+} dyntexture_t;
+
+static pixelbuffer_t g_ring[PBO_RING];
+static int g_ring_index = 0;
+static dyntexture_t* g_dyntextures = NULL;
+
+static GLenum pixel_format(textureformat_t format)
+{
+	return format == FORMAT_BGRA ? GL_BGRA : GL_RGBA;
+}
+
+static dyntexture_t* find_dyntexture(texture_t texture)
+{
+	dyntexture_t* ptr = g_dyntextures;
+	while ( ptr && ptr->texture != texture ) ptr = ptr->next;
+	return ptr;
+}
+
+texture_t _create_texture(int width, int height, textureformat_t format)
+{
+	dyntexture_t* data;
+	GLuint texture;
+
+	if ( width <= 0 || height <= 0 ) return 0;
+
+	flush_batch(FLUSH_RESOURCE);
+
+	glGenTextures(1, &texture);
+	gl_bind_texture(0, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, pixel_format(format), GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	track_texture(texture, width, height, 4, NULL);
+
+	data = (dyntexture_t*) mem_alloc(sizeof(dyntexture_t), MEMORY_GENERAL);
+	data->texture = texture;
+	data->width = width;
+	data->height = height;
+	data->format = format;
+	data->next = g_dyntextures;
+	g_dyntextures = data;
+
+	return texture;
+}
+
+//pixels are width x height tightly packed rows in the texture's format
+void _update_texture(texture_t texture, int x, int y, int width, int height, const void* pixels)
+{
+	dyntexture_t* data = find_dyntexture(texture);
+	pixelbuffer_t* slot;
+	int bytes;
+	void* mapped;
+
+	if ( data == NULL || pixels == NULL || width <= 0 || height <= 0 ) return;
+	if ( x < 0 || y < 0 || x + width > data->width || y + height > data->height ) return;
+
+	//quads already batched with this texture have to draw with the old contents
+	flush_batch(FLUSH_RESOURCE);
+	gl_bind_texture(0, texture);
+
+	if ( gfx_compat() )
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, pixel_format(data->format), GL_UNSIGNED_BYTE, pixels);
+		g_frame_stats.bytes_uploaded += width * height * 4;
+		return;
+	}
+
+	bytes = width * height * 4;
+	g_frame_stats.bytes_uploaded += bytes;
+	slot = &g_ring[g_ring_index];
+	g_ring_index = (g_ring_index + 1) % PBO_RING;
+
+	if ( slot->pbo == 0 ) glGenBuffers(1, &slot->pbo);
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, slot->pbo);
+
+	if ( slot->size < bytes )
+	{
+		slot->size = bytes;
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, slot->size, NULL, GL_STREAM_DRAW);
+	}
+	else if ( slot->fence && glClientWaitSync(slot->fence, 0, 0) == GL_TIMEOUT_EXPIRED )
+	{
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, slot->size, NULL, GL_STREAM_DRAW);
+	}
+
+	if ( slot->fence )
+	{
+		glDeleteSync(slot->fence);
+		slot->fence = NULL;
+	}
+
+	//either the last upload from this buffer finished or the storage is new
+	mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	if ( mapped )
+	{
+		memcpy(mapped, pixels, bytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, pixel_format(data->format), GL_UNSIGNED_BYTE, (void*) 0);
+		slot->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
+
+void forget_dynamic_texture(texture_t texture)
+{
+	dyntexture_t** link = &g_dyntextures;
+	while ( *link && (*link)->texture != texture ) link = &(*link)->next;
+
+	if ( *link )
+	{
+		dyntexture_t* data = *link;
+		*link = data->next;
+		mem_free(data);
+	}
+}
+
+void free_texture_streams(void)
+{
+	int i;
+	for (i=0; i<PBO_RING; ++i)
+	{
+		if ( g_ring[i].fence ) glDeleteSync(g_ring[i].fence);
+		if ( g_ring[i].pbo ) gl_delete_buffer(g_ring[i].pbo);
+	}
+	memset(g_ring, 0, sizeof(g_ring));
+	g_ring_index = 0;
+
+	while ( g_dyntextures ) forget_dynamic_texture(g_dyntextures->texture);
+}
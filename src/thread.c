@@ -0,0 +1,266 @@
+#include "memory.h"
+#include "thread.h"
+
+#ifdef _WIN32
+
+#include <windows.h>
+
+typedef struct
+{
+	thread_func func;
+	void* arg;
+} threadstart_t;
+
+static DWORD WINAPI thread_entry(LPVOID param)
+{
+	threadstart_t start = *(threadstart_t*) param;
+	HeapFree(GetProcessHeap(), 0, param);
+	start.func(start.arg);
+	return 0;
+}
+
+thread_t thread_create(thread_func func, void* arg)
+{
+	threadstart_t* start = (threadstart_t*) HeapAlloc(GetProcessHeap(), 0, sizeof(threadstart_t));
+	HANDLE handle;
+	start->func = func;
+	start->arg = arg;
+
+	handle = CreateThread(NULL, 0, thread_entry, start, 0, NULL);
+	if ( handle == NULL ) HeapFree(GetProcessHeap(), 0, start);
+	return handle;
+}
+
+void thread_join(thread_t thread)
+{
+	WaitForSingleObject((HANDLE) thread, INFINITE);
+	CloseHandle((HANDLE) thread);
+}
+
+void thread_yield(void)
+{
+	SwitchToThread();
+}
+
+int thread_cpu_count(void)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+}
+
+mutex_t mutex_create(void)
+{
+	CRITICAL_SECTION* cs = (CRITICAL_SECTION*) HeapAlloc(GetProcessHeap(), 0, sizeof(CRITICAL_SECTION));
+	InitializeCriticalSectionAndSpinCount(cs, 1000);
+	return cs;
+}
+
+void mutex_free(mutex_t mutex)
+{
+	DeleteCriticalSection((CRITICAL_SECTION*) mutex);
+	HeapFree(GetProcessHeap(), 0, mutex);
+}
+
+void mutex_lock(mutex_t mutex)
+{
+	EnterCriticalSection((CRITICAL_SECTION*) mutex);
+}
+
+void mutex_unlock(mutex_t mutex)
+{
+	LeaveCriticalSection((CRITICAL_SECTION*) mutex);
+}
+
+semaphore_t semaphore_create(void)
+{
+	return CreateSemaphore(NULL, 0, 0x7FFFFFFF, NULL);
+}
+
+void semaphore_free(semaphore_t sem)
+{
+	CloseHandle((HANDLE) sem);
+}
+
+void semaphore_post(semaphore_t sem, int count)
+{
+	ReleaseSemaphore((HANDLE) sem, count, NULL);
+}
+
+bool semaphore_wait(semaphore_t sem, int timeout_ms)
+{
+	return WaitForSingleObject((HANDLE) sem, timeout_ms < 0 ? INFINITE : (DWORD) timeout_ms) == WAIT_OBJECT_0;
+}
+
+long long atomic_get(volatile long long* value)
+{
+	return InterlockedCompareExchange64(value, 0, 0);
+}
+
+void atomic_set(volatile long long* value, long long x)
+{
+	InterlockedExchange64(value, x);
+}
+
+long long atomic_add(volatile long long* value, long long x)
+{
+	return InterlockedExchangeAdd64(value, x) + x;
+}
+
+bool atomic_cas(volatile long long* value, long long expected, long long desired)
+{
+	return InterlockedCompareExchange64(value, desired, expected) == expected;
+}
+
+void atomic_fence(void)
+{
+	MemoryBarrier();
+}
+
+#else
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+
+typedef struct
+{
+	pthread_t handle;
+	thread_func func;
+	void* arg;
+} threaddata_t;
+
+static void* thread_entry(void* param)
+{
+	threaddata_t* data = (threaddata_t*) param;
+	data->func(data->arg);
+	return NULL;
+}
+
+thread_t thread_create(thread_func func, void* arg)
+{
+	threaddata_t* data = (threaddata_t*) mem_alloc(sizeof(threaddata_t), MEMORY_GENERAL);
+	data->func = func;
+	data->arg = arg;
+
+	if ( pthread_create(&data->handle, NULL, thread_entry, data) != 0 )
+	{
+		mem_free(data);
+		return NULL;
+	}
+	return data;
+}
+
+void thread_join(thread_t thread)
+{
+	threaddata_t* data = (threaddata_t*) thread;
+	pthread_join(data->handle, NULL);
+	mem_free(data);
+}
+
+void thread_yield(void)
+{
+	sched_yield();
+}
+
+int thread_cpu_count(void)
+{
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int) count : 1;
+}
+
+mutex_t mutex_create(void)
+{
+	pthread_mutex_t* mutex = (pthread_mutex_t*) mem_alloc(sizeof(pthread_mutex_t), MEMORY_GENERAL);
+	pthread_mutex_init(mutex, NULL);
+	return mutex;
+}
+
+void mutex_free(mutex_t mutex)
+{
+	pthread_mutex_destroy((pthread_mutex_t*) mutex);
+	mem_free(mutex);
+}
+
+void mutex_lock(mutex_t mutex)
+{
+	pthread_mutex_lock((pthread_mutex_t*) mutex);
+}
+
+void mutex_unlock(mutex_t mutex)
+{
+	pthread_mutex_unlock((pthread_mutex_t*) mutex);
+}
+
+semaphore_t semaphore_create(void)
+{
+	sem_t* sem = (sem_t*) mem_alloc(sizeof(sem_t), MEMORY_GENERAL);
+	sem_init(sem, 0, 0);
+	return sem;
+}
+
+void semaphore_free(semaphore_t sem)
+{
+	sem_destroy((sem_t*) sem);
+	mem_free(sem);
+}
+
+void semaphore_post(semaphore_t sem, int count)
+{
+	while ( count-- > 0 ) sem_post((sem_t*) sem);
+}
+
+bool semaphore_wait(semaphore_t sem, int timeout_ms)
+{
+	struct timespec ts;
+	int result;
+
+	if ( timeout_ms < 0 )
+	{
+		while ( (result = sem_wait((sem_t*) sem)) != 0 && errno == EINTR );
+		return result == 0;
+	}
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout_ms / 1000;
+	ts.tv_nsec += (timeout_ms % 1000) * 1000000L;
+	if ( ts.tv_nsec >= 1000000000L )
+	{
+		ts.tv_sec += 1;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	while ( (result = sem_timedwait((sem_t*) sem, &ts)) != 0 && errno == EINTR );
+	return result == 0;
+}
+
+long long atomic_get(volatile long long* value)
+{
+	return __atomic_load_n(value, __ATOMIC_SEQ_CST);
+}
+
+void atomic_set(volatile long long* value, long long x)
+{
+	__atomic_store_n(value, x, __ATOMIC_SEQ_CST);
+}
+
+long long atomic_add(volatile long long* value, long long x)
+{
+	return __atomic_add_fetch(value, x, __ATOMIC_SEQ_CST);
+}
+
+bool atomic_cas(volatile long long* value, long long expected, long long desired)
+{
+	return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+void atomic_fence(void)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif //_WIN32
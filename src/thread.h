@@ -0,0 +1,41 @@
+#ifndef GAMELIB_THREAD_H
+#define GAMELIB_THREAD_H
+
+#include "lib.h"
+
+//minimal platform layer for the job system, win32 threads or pthreads
+
+#ifdef _WIN32
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+typedef void* thread_t;
+typedef void* mutex_t;
+typedef void* semaphore_t;
+typedef void (*thread_func)(void* arg);
+
+extern thread_t thread_create(thread_func func, void* arg);
+extern void thread_join(thread_t thread);
+extern void thread_yield(void);
+extern int thread_cpu_count(void);
+
+extern mutex_t mutex_create(void);
+extern void mutex_free(mutex_t mutex);
+extern void mutex_lock(mutex_t mutex);
+extern void mutex_unlock(mutex_t mutex);
+
+extern semaphore_t semaphore_create(void);
+extern void semaphore_free(semaphore_t sem);
+extern void semaphore_post(semaphore_t sem, int count);
+extern bool semaphore_wait(semaphore_t sem, int timeout_ms);
+
+//sequentially consistent atomics on 64-bit integers
+extern long long atomic_get(volatile long long* value);
+extern void atomic_set(volatile long long* value, long long x);
+extern long long atomic_add(volatile long long* value, long long x);
+extern bool atomic_cas(volatile long long* value, long long expected, long long desired);
+extern void atomic_fence(void);
+
+#endif //GAMELIB_THREAD_H
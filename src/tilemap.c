@@ -0,0 +1,197 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "draw.h"
+#include "memory.h"
+#include "thread.h"
+
+//tiles live in fixed size chunks, each chunk owns a static mesh that is rebuilt the
+//next time it's drawn after one of its tiles changes
+#define CHUNK_SIZE 32
+#define CHUNK_TILES (CHUNK_SIZE * CHUNK_SIZE)
+
+typedef struct
+{
+	short tiles[CHUNK_TILES];
+	mesh_t mesh;
+	bool dirty;
+} tilechunk_t;
+
+typedef struct
+{
+	int width;
+	int height;
+	int chunks_x;
+	int chunks_y;
+	float tile_size;
+	texture_t atlas;
+	int atlas_columns;
+	int atlas_rows;
+	tilechunk_t* chunks;
+	mutex_t lock; //edits can race the render thread rebuilding chunks
+} tilemapdata_t;
+
+tilemap_t _create_tilemap(int width, int height, float tile_size, texture_t atlas, int atlas_columns, int atlas_rows)
+{
+	tilemapdata_t* map;
+	int i;
+
+	if ( width <= 0 || height <= 0 || atlas_columns <= 0 || atlas_rows <= 0 ) return NULL;
+
+	map = (tilemapdata_t*) mem_alloc(sizeof(tilemapdata_t), MEMORY_GEOMETRY);
+	map->width = width;
+	map->height = height;
+	map->chunks_x = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	map->chunks_y = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	map->tile_size = tile_size;
+	map->atlas = atlas;
+	map->atlas_columns = atlas_columns;
+	map->atlas_rows = atlas_rows;
+	map->chunks = (tilechunk_t*) mem_alloc(sizeof(tilechunk_t) * map->chunks_x * map->chunks_y, MEMORY_GEOMETRY);
+	map->lock = mutex_create();
+
+	for (i=0; i<map->chunks_x * map->chunks_y; ++i)
+	{
+		tilechunk_t* chunk = &map->chunks[i];
+		memset(chunk->tiles, 0xFF, sizeof(chunk->tiles));
+		chunk->mesh = NULL;
+		chunk->dirty = false;
+	}
+
+	return map;
+}
+
+void _free_tilemap(tilemap_t tilemap)
+{
+	tilemapdata_t* map = (tilemapdata_t*) tilemap;
+	int i;
+	if ( map == NULL ) return;
+
+	for (i=0; i<map->chunks_x * map->chunks_y; ++i)
+	{
+		if ( map->chunks[i].mesh ) _free_mesh(map->chunks[i].mesh);
+	}
+
+	mutex_free(map->lock);
+	mem_free(map->chunks);
+	mem_free(map);
+}
+
+void _set_tile(tilemap_t tilemap, int x, int y, int tile)
+{
+	tilemapdata_t* map = (tilemapdata_t*) tilemap;
+	tilechunk_t* chunk;
+	short* slot;
+
+	//tiles are stored as shorts, larger indices would wrap to a different cell
+	if ( x < 0 || y < 0 || x >= map->width || y >= map->height || tile > SHRT_MAX ) return;
+	if ( tile < 0 ) tile = -1;
+
+	chunk = &map->chunks[(y / CHUNK_SIZE) * map->chunks_x + (x / CHUNK_SIZE)];
+	slot = &chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + (x % CHUNK_SIZE)];
+	if ( *slot == tile ) return;
+
+	mutex_lock(map->lock);
+	*slot = (short) tile;
+	chunk->dirty = true;
+	mutex_unlock(map->lock);
+}
+
+int _get_tile(tilemap_t tilemap, int x, int y)
+{
+	tilemapdata_t* map = (tilemapdata_t*) tilemap;
+	tilechunk_t* chunk;
+
+	if ( x < 0 || y < 0 || x >= map->width || y >= map->height ) return -1;
+
+	chunk = &map->chunks[(y / CHUNK_SIZE) * map->chunks_x + (x / CHUNK_SIZE)];
+	return chunk->tiles[(y % CHUNK_SIZE) * CHUNK_SIZE + (x % CHUNK_SIZE)];
+}
+
+//vertices are relative to the chunk origin, the chunk is placed with its draw transform
+static void rebuild_chunk(tilemapdata_t* map, tilechunk_t* chunk)
+{
+	colorvertex_t* vertices = (colorvertex_t*) temp_alloc(sizeof(colorvertex_t) * 4 * CHUNK_TILES);
+	unsigned int* indices = (unsigned int*) temp_alloc(sizeof(unsigned int) * 6 * CHUNK_TILES);
+	float su = 1.f / map->atlas_columns;
+	float sv = 1.f / map->atlas_rows;
+	int num_quads = 0;
+	int i;
+
+	mutex_lock(map->lock);
+	for (i=0; i<CHUNK_TILES; ++i)
+	{
+		int tile = chunk->tiles[i];
+		colorvertex_t* v = vertices + num_quads * 4;
+		unsigned int* index = indices + num_quads * 6;
+		unsigned int base = num_quads * 4;
+		float x, y, u, w;
+
+		if ( tile < 0 ) continue;
+
+		x = (i % CHUNK_SIZE) * map->tile_size;
+		y = (i / CHUNK_SIZE) * map->tile_size;
+		u = (tile % map->atlas_columns) * su;
+		w = ((tile / map->atlas_columns) % map->atlas_rows) * sv;
+
+		build_rect(v, x, y, map->tile_size, map->tile_size, 0xFFFFFFFF);
+		v[0].u = u; v[0].v = w;
+		v[1].u = u + su; v[1].v = w;
+		v[2].u = u + su; v[2].v = w + sv;
+		v[3].u = u; v[3].v = w + sv;
+
+		index[0] = base + 0; index[1] = base + 1; index[2] = base + 2;
+		index[3] = base + 0; index[4] = base + 2; index[5] = base + 3;
+		++num_quads;
+	}
+	chunk->dirty = false;
+	mutex_unlock(map->lock);
+
+	if ( chunk->mesh ) _free_mesh(chunk->mesh);
+	chunk->mesh = num_quads ? _create_mesh(vertices, num_quads * 4, indices, num_quads * 6) : NULL;
+
+	temp_free(vertices);
+	temp_free(indices);
+}
+
+void _draw_tilemap(tilemap_t tilemap, float x, float y)
+{
+	tilemapdata_t* map = (tilemapdata_t*) tilemap;
+	float chunk_extent;
+	float x0, y0, x1, y1;
+	int cx0, cy0, cx1, cy1;
+	int cx, cy;
+	texture_t saved;
+
+	if ( map == NULL || map->tile_size <= 0.f ) return;
+
+	chunk_extent = map->tile_size * CHUNK_SIZE;
+	get_view_rect(&x0, &y0, &x1, &y1);
+
+	cx0 = (int) floorf((x0 - x) / chunk_extent);
+	cy0 = (int) floorf((y0 - y) / chunk_extent);
+	cx1 = (int) floorf((x1 - x) / chunk_extent);
+	cy1 = (int) floorf((y1 - y) / chunk_extent);
+	if ( cx0 < 0 ) cx0 = 0;
+	if ( cy0 < 0 ) cy0 = 0;
+	if ( cx1 >= map->chunks_x ) cx1 = map->chunks_x - 1;
+	if ( cy1 >= map->chunks_y ) cy1 = map->chunks_y - 1;
+	if ( cx0 > cx1 || cy0 > cy1 ) return;
+
+	saved = current_texture();
+	_set_texture(map->atlas);
+
+	for (cy=cy0; cy<=cy1; ++cy)
+	{
+		for (cx=cx0; cx<=cx1; ++cx)
+		{
+			tilechunk_t* chunk = &map->chunks[cy * map->chunks_x + cx];
+			transform_t transform = TRANSFORM(x + cx * chunk_extent, y + cy * chunk_extent, 0.f, 1.f);
+
+			if ( chunk->dirty ) rebuild_chunk(map, chunk);
+			if ( chunk->mesh ) _draw_mesh(chunk->mesh, &transform);
+		}
+	}
+
+	_set_texture(saved);
+}
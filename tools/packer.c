@@ -0,0 +1,197 @@
+//builds asset archives for gamelib's mount_pack / initparams_t.asset_pack
+//usage: packer out.pak file [file...] [@listfile]
+//a listfile names one file per line, blank lines and lines starting with # are skipped
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/pack.h"
+
+typedef struct
+{
+	char path[PACK_MAX_PATH];
+	char name[PACK_MAX_PATH];
+	unsigned int hash;
+	unsigned long long size;
+} packfile_t;
+
+static packfile_t* g_files = NULL;
+static int g_num_files = 0;
+static int g_max_files = 0;
+
+static bool add_file(const char* path)
+{
+	packfile_t* file;
+	FILE* fp;
+	int i;
+
+	if ( strlen(path) >= PACK_MAX_PATH )
+	{
+		printf("PATH TOO LONG %s\n", path);
+		return false;
+	}
+
+	fp = fopen(path, "rb");
+	if ( !fp )
+	{
+		printf("CAN'T FIND %s\n", path);
+		return false;
+	}
+
+	if ( g_num_files == g_max_files )
+	{
+		g_max_files = g_max_files ? g_max_files * 2 : 64;
+		g_files = (packfile_t*) realloc(g_files, sizeof(packfile_t) * g_max_files);
+	}
+
+	file = &g_files[g_num_files];
+	strcpy(file->path, path);
+	pack_normalize(file->name, path);
+	file->hash = pack_hash(file->name);
+
+	fseek(fp, 0, SEEK_END);
+	file->size = (unsigned long long) ftell(fp);
+	fclose(fp);
+
+	for (i=0; i<g_num_files; ++i)
+	{
+		if ( strcmp(g_files[i].name, file->name) == 0 )
+		{
+			printf("DUPLICATE %s\n", path);
+			return true;
+		}
+	}
+
+	g_num_files++;
+	return true;
+}
+
+static bool add_list(const char* listfile)
+{
+	char line[PACK_MAX_PATH];
+	FILE* fp = fopen(listfile, "r");
+	bool ok = true;
+
+	if ( !fp )
+	{
+		printf("CAN'T FIND %s\n", listfile);
+		return false;
+	}
+
+	while ( fgets(line, sizeof(line), fp) )
+	{
+		char* start = line;
+		char* end = line + strlen(line);
+
+		while ( *start && isspace((unsigned char) *start) ) ++start;
+		while ( end > start && isspace((unsigned char) end[-1]) ) --end;
+		*end = 0;
+		if ( *start == 0 || *start == '#' ) continue;
+
+		ok = add_file(start) && ok;
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+static int compare_files(const void* a, const void* b)
+{
+	unsigned int ha = ((const packfile_t*) a)->hash;
+	unsigned int hb = ((const packfile_t*) b)->hash;
+	return ha < hb ? -1 : ha > hb ? 1 : 0;
+}
+
+static bool copy_file(FILE* out, const char* path)
+{
+	char buffer[65536];
+	size_t count;
+	FILE* fp = fopen(path, "rb");
+	if ( !fp ) return false;
+
+	while ( (count = fread(buffer, 1, sizeof(buffer), fp)) > 0 ) fwrite(buffer, 1, count, out);
+	fclose(fp);
+	return true;
+}
+
+static void pad_to(FILE* out, unsigned long long offset)
+{
+	static const char zeros[PACK_ALIGN] = {0};
+	unsigned long long at = (unsigned long long) ftell(out);
+	if ( offset > at ) fwrite(zeros, 1, (size_t) (offset - at), out);
+}
+
+int main(int argc, const char** argv)
+{
+	packheader_t header;
+	packentry_t* entries;
+	unsigned long long offset;
+	unsigned int names_size = 0;
+	FILE* out;
+	int i;
+
+	if ( argc < 3 )
+	{
+		printf("usage: packer out.pak file [file...] [@listfile]\n");
+		return 1;
+	}
+
+	for (i=2; i<argc; ++i)
+	{
+		bool ok = argv[i][0] == '@' ? add_list(argv[i] + 1) : add_file(argv[i]);
+		if ( !ok ) return 1;
+	}
+
+	qsort(g_files, g_num_files, sizeof(packfile_t), compare_files);
+
+	//lay out the index, names and aligned contents
+	entries = (packentry_t*) calloc(g_num_files ? g_num_files : 1, sizeof(packentry_t));
+	for (i=0; i<g_num_files; ++i)
+	{
+		entries[i].hash = g_files[i].hash;
+		entries[i].name_offset = names_size;
+		entries[i].size = g_files[i].size;
+		names_size += (unsigned int) strlen(g_files[i].name) + 1;
+	}
+
+	header.magic = PACK_MAGIC;
+	header.version = PACK_VERSION;
+	header.num_entries = (unsigned int) g_num_files;
+	header.names_offset = (unsigned int) (sizeof(packheader_t) + sizeof(packentry_t) * g_num_files);
+
+	offset = header.names_offset + names_size;
+	for (i=0; i<g_num_files; ++i)
+	{
+		offset = (offset + PACK_ALIGN - 1) & ~(unsigned long long) (PACK_ALIGN - 1);
+		entries[i].offset = offset;
+		offset += entries[i].size;
+	}
+
+	out = fopen(argv[1], "wb");
+	if ( !out )
+	{
+		printf("CAN'T WRITE %s\n", argv[1]);
+		return 1;
+	}
+
+	fwrite(&header, sizeof(packheader_t), 1, out);
+	fwrite(entries, sizeof(packentry_t), g_num_files, out);
+	for (i=0; i<g_num_files; ++i) fwrite(g_files[i].name, 1, strlen(g_files[i].name) + 1, out);
+
+	for (i=0; i<g_num_files; ++i)
+	{
+		pad_to(out, entries[i].offset);
+		if ( !copy_file(out, g_files[i].path) )
+		{
+			printf("CAN'T READ %s\n", g_files[i].path);
+			fclose(out);
+			return 1;
+		}
+		printf("PACK %s : %llu bytes\n", g_files[i].name, entries[i].size);
+	}
+
+	fclose(out);
+	free(entries);
+	free(g_files);
+	return 0;
+}